@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+#include "body-file.h"
+#include "syscall-stats.h"
+
+/* Open addressing, at most half full */
+static struct body_file **table;
+static unsigned int table_size, num_files;
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static uint32_t
+hash_path(const char *path)
+{
+	uint32_t h = 2166136261u; /* FNV-1a */
+
+	for (; *path; path++)
+		h = (h ^ (unsigned char)*path) * 16777619u;
+	return h;
+}
+
+static struct body_file **
+find_slot(struct body_file **t, unsigned int size, const char *path)
+{
+	unsigned int n;
+
+	for (n = hash_path(path) % size; t[n]; n = (n + 1) % size) {
+		if (!strcmp(t[n]->path, path))
+			break;
+	}
+	return &t[n];
+}
+
+static void
+grow_table(void)
+{
+	unsigned int new_size = table_size ? 2 * table_size : 64, n;
+	struct body_file **t = xrealloc(NULL, new_size * sizeof t[0]);
+
+	memset(t, 0, new_size * sizeof t[0]);
+	for (n = 0; n < table_size; n++) {
+		if (table[n])
+			*find_slot(t, new_size, table[n]->path) = table[n];
+	}
+	free(table);
+	table = t;
+	table_size = new_size;
+}
+
+const struct body_file *
+body_file_open(const char *path, int min_fd)
+{
+	if (2 * (num_files + 1) > table_size)
+		grow_table();
+	struct body_file **slot = find_slot(table, table_size, path);
+	if (*slot)
+		return *slot;
+
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st) == -1) {
+		fprintf(stderr, "Cannot open POST body '%s': %s\n", path, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (!S_ISREG(st.st_mode)) {
+		fprintf(stderr, "POST body '%s' is not a regular file\n", path);
+		exit(EXIT_FAILURE);
+	}
+	int high_fd = fcntl(fd, F_DUPFD_CLOEXEC, min_fd);
+	if (high_fd == -1) {
+		fprintf(stderr, "Cannot keep POST body '%s' open: %s%s\n", path, strerror(errno),
+			errno == EMFILE || errno == EINVAL ? " (raise ulimit -n)" : "");
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+
+	struct body_file *b = xrealloc(NULL, sizeof *b);
+	b->path = strdup(path);
+	b->fd = high_fd;
+	b->offset = 0;
+	b->size = st.st_size;
+	*slot = b;
+	num_files++;
+	return b;
+}
+
+ssize_t
+body_file_send(int sock, const struct body_file *b, off_t offset)
+{
+	size_t left = b->size - offset;
+	offset += b->offset;
+#ifdef __linux__
+	count_syscall(SC_SENDFILE);
+	return sendfile(sock, b->fd, &offset, left);
+#else
+	char chunk[65536];
+	if (left > sizeof chunk)
+		left = sizeof chunk;
+	ssize_t got = pread(b->fd, chunk, left, offset);
+	count_syscall(SC_READ);
+	if (got <= 0)
+		return got;
+	count_syscall(SC_WRITE);
+	return write(sock, chunk, got);
+#endif
+}
+
+unsigned int
+body_files_open(void)
+{
+	return num_files;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
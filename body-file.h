@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef BODY_FILE_H
+#define BODY_FILE_H
+
+/* POST bodies that live in files, for queries written as @<path>. Each file
+ * is opened once, and the body goes from the page cache to the socket with
+ * sendfile() where there is one, so bodies of any size cost no copying in
+ * user space. */
+
+#include <sys/types.h>
+
+struct body_file {
+	const char *path;
+	int fd;
+	off_t offset; /* Where the body starts in the file */
+	off_t size;
+};
+
+/* Open path, or return the one already open. The descriptor is moved to
+   min_fd or above, to stay out of the range used for connections. */
+const struct body_file *body_file_open(const char *path, int min_fd);
+/* Send from offset in the body on, returns what write() would */
+ssize_t body_file_send(int sock, const struct body_file *, off_t offset);
+unsigned int body_files_open(void);
+
+#endif /* !BODY_FILE_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* splice */
+#endif
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "body-sink.h"
+#include "connection-info.h"
+#include "syscall-stats.h"
+
+#ifdef SPLICE_F_MOVE
+
+enum { SINK_PIPE_SIZE = 1 << 20 };
+
+static int pipe_fds[2] = { -1, -1 };
+static int null_fd = -1;
+static size_t pipe_size;
+
+int
+body_sink_supported(void)
+{
+	return 1;
+}
+
+void
+body_sink_init(void)
+{
+	if (pipe(pipe_fds) == -1) {
+		fprintf(stderr, "Cannot create pipe: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	null_fd = open("/dev/null", O_WRONLY);
+	if (null_fd == -1) {
+		fprintf(stderr, "Cannot open /dev/null: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	pipe_fds[0] = fd_above_connections(pipe_fds[0]);
+	pipe_fds[1] = fd_above_connections(pipe_fds[1]);
+	null_fd = fd_above_connections(null_fd);
+	/* A bigger pipe means fewer splices per body. May fail if
+	   /proc/sys/fs/pipe-max-size is lower, then we live with the default. */
+	int size = fcntl(pipe_fds[1], F_SETPIPE_SZ, SINK_PIPE_SIZE);
+	if (size == -1)
+		size = fcntl(pipe_fds[1], F_GETPIPE_SZ);
+	pipe_size = size > 0 ? (size_t)size : 65536;
+}
+
+ssize_t
+body_sink(int fd, size_t max)
+{
+	if (max > pipe_size)
+		max = pipe_size;
+
+	ssize_t len = splice(fd, NULL, pipe_fds[1], NULL, max, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	count_syscall(SC_SPLICE);
+	if (len <= 0)
+		return len;
+
+	/* Empty the pipe again right away, so it is always empty between calls */
+	ssize_t left = len;
+	while (left > 0) {
+		ssize_t out = splice(pipe_fds[0], NULL, null_fd, NULL, left, SPLICE_F_MOVE);
+		count_syscall(SC_SPLICE);
+		if (out <= 0) {
+			fprintf(stderr, "splice to /dev/null fails: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		left -= out;
+	}
+	return len;
+}
+
+#else /* !SPLICE_F_MOVE */
+
+int
+body_sink_supported(void)
+{
+	return 0;
+}
+
+void
+body_sink_init(void)
+{
+}
+
+ssize_t
+body_sink(int fd, size_t max)
+{
+	(void)fd;
+	(void)max;
+	errno = ENOSYS;
+	return -1;
+}
+
+#endif /* SPLICE_F_MOVE */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
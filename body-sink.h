@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef BODY_SINK_H
+#define BODY_SINK_H
+
+/* Throw away response bodies without copying them to user space, by
+ * splicing them from the socket through a pipe into /dev/null. */
+
+#include <sys/types.h>
+
+int body_sink_supported(void);
+void body_sink_init(void);
+ssize_t body_sink(int fd, size_t max); /* Like read(), but the data is gone */
+
+#endif /* !BODY_SINK_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,755 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "cluster.h"
+#include "debug.h"
+#include "timeutil.h"
+#include "connection-info.h"
+#include "wait-interface.h"
+#include "stats.h"
+#include "target.h"
+#include "group.h"
+#include "histogram.h"
+
+/* The protocol, over one TCP connection per agent:
+ *
+ *   coordinator: JOB <token> <index> <agents> <seed> <argc> <corpus bytes>\n
+ *                <argc NUL terminated arguments><corpus>
+ *   agent:       READY\n
+ *   coordinator: GO\n
+ *   agent:       P <sent> <completed> <rate>\n   every second
+ *   coordinator: STOP\n                          if interrupted
+ *   agent:       R <bytes>\n<report>
+ *
+ * The report is binary in host byte order, both ends are expected to run
+ * the same build on the same kind of machine. It starts with a magic
+ * number and the histogram size to catch the worst mismatches.
+ *
+ * An agent runs whatever command line it is sent, so the coordinator must
+ * prove it knows the secret in CXBENCH_TOKEN, which both ends have. */
+
+enum {
+	REPORT_MAGIC = 0x43584232, /* CXB2 */
+	MAX_LINE = 256,
+	MAX_TOKEN = 64, /* Matches the %64s in read_job() */
+};
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static void
+send_all(int fd, const void *buf, size_t len)
+{
+	const char *p = buf;
+	while (len) {
+		ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+		if (n == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "cluster: send fails: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+static void
+recv_all(int fd, void *buf, size_t len)
+{
+	char *p = buf;
+	while (len) {
+		ssize_t n = read(fd, p, len);
+		if (n == -1 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			fprintf(stderr, "cluster: connection lost: %s\n",
+				n ? strerror(errno) : "EOF");
+			exit(EXIT_FAILURE);
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+/* A byte at a time, this is only for the few lines before the run */
+static void
+recv_line(int fd, char *line, size_t size)
+{
+	size_t len = 0;
+	while (len + 1 < size) {
+		recv_all(fd, &line[len], 1);
+		if (line[len] == '\n')
+			break;
+		len++;
+	}
+	line[len] = 0;
+}
+
+static void
+send_line(int fd, const char *line)
+{
+	send_all(fd, line, strlen(line));
+}
+
+static const char *
+cluster_token(void)
+{
+	const char *token = getenv("CXBENCH_TOKEN");
+	if (!token || !*token || strlen(token) > MAX_TOKEN || strpbrk(token, " \t\r\n")) {
+		fprintf(stderr, "Set CXBENCH_TOKEN to the same secret on the coordinator and the "
+			"agents, at most %d characters without spaces\n", MAX_TOKEN);
+		exit(EXIT_FAILURE);
+	}
+	return token;
+}
+
+/* Agent */
+
+/* Without an early return, so the time taken tells nothing about the token */
+static int
+token_matches(const char *token, const char *got)
+{
+	size_t n, len = strlen(token), got_len = strlen(got);
+	unsigned int diff = len != got_len;
+
+	for (n = 0; n < len; n++)
+		diff |= (unsigned char)token[n] ^ (unsigned char)(n < got_len ? got[n] : 0);
+	return !diff;
+}
+
+static void
+read_job(int fd, const char *token, struct cluster_job *job)
+{
+	char line[MAX_LINE], got[MAX_TOKEN + 1];
+	unsigned long long seed, corpus_len;
+	int n;
+
+	recv_line(fd, line, sizeof line);
+	if (sscanf(line, "JOB %64s %u %u %llu %d %llu", got, &job->index, &job->num_agents,
+		   &seed, &job->argc, &corpus_len) != 6 || job->argc < 1) {
+		fprintf(stderr, "agent: bad job\n");
+		exit(EXIT_FAILURE);
+	}
+	if (!token_matches(token, got)) {
+		fprintf(stderr, "agent: job with the wrong CXBENCH_TOKEN, ignored\n");
+		exit(EXIT_FAILURE);
+	}
+	job->seed = seed;
+
+	/* The arguments go in one buffer, and argv points into it once it is complete */
+	struct dynbuf args;
+	dynbuf_init(&args);
+	for (n = 0; n < job->argc; ) {
+		dynbuf_ensure_space(&args, 1);
+		recv_all(fd, &args.buffer[args.pos], 1);
+		if (!args.buffer[args.pos++])
+			n++;
+	}
+	job->argv = calloc(job->argc + 1, sizeof job->argv[0]);
+	if (!job->argv) {
+		fprintf(stderr, "agent: calloc fails: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	char *arg = args.buffer;
+	for (n = 0; n < job->argc; n++) {
+		job->argv[n] = arg;
+		arg += strlen(arg) + 1;
+	}
+
+	dynbuf_init(&job->queries);
+	dynbuf_ensure_space(&job->queries, corpus_len + 1);
+	recv_all(fd, job->queries.buffer, corpus_len);
+	job->queries.pos = corpus_len;
+	fprintf(stderr, "Got a job as agent %u of %u, %llu bytes of queries\n",
+		job->index + 1, job->num_agents, corpus_len);
+}
+
+int
+agent_serve(const char *address, unsigned int port, struct cluster_job *job)
+{
+	struct sockaddr_in sin;
+	const int one = 1;
+	const char *token = cluster_token();
+	int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	int fd;
+
+	if (listen_fd == -1) {
+		fprintf(stderr, "agent: socket() fails: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+	memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(port);
+	if (address && inet_pton(AF_INET, address, &sin.sin_addr) != 1) {
+		fprintf(stderr, "agent: invalid IPv4 address '%s'\n", address);
+		exit(EXIT_FAILURE);
+	}
+	if (bind(listen_fd, (struct sockaddr *)&sin, sizeof sin) == -1
+	    || listen(listen_fd, 16) == -1) {
+		fprintf(stderr, "agent: cannot listen on %s:%u: %s\n", inet_ntoa(sin.sin_addr), port,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fprintf(stderr, "Agent waiting for a coordinator on %s:%u\n", inet_ntoa(sin.sin_addr),
+		port);
+
+	/* Every job runs in its own process, so it starts from a clean slate */
+	while (1) {
+		fd = accept(listen_fd, NULL, NULL);
+		if (fd == -1) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			fprintf(stderr, "agent: accept fails: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		while (waitpid(-1, NULL, WNOHANG) > 0)
+			;
+		pid_t pid = fork();
+		if (pid == 0)
+			break;
+		if (pid == -1)
+			fprintf(stderr, "agent: fork fails: %s\n", strerror(errno));
+		close(fd);
+	}
+	close(listen_fd);
+	read_job(fd, token, job);
+	return fd;
+}
+
+void
+agent_ready(int fd)
+{
+	char line[MAX_LINE];
+
+	send_line(fd, "READY\n");
+	recv_line(fd, line, sizeof line);
+	if (strcmp(line, "GO") != 0) {
+		fprintf(stderr, "agent: expected GO from the coordinator, got '%s'\n", line);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static struct conn_info coordinator;
+static int *coordinator_fd; /* The caller's, set to -1 once the coordinator is gone */
+static volatile unsigned int *agent_stop;
+
+/* The coordinator only ever says STOP, or goes away */
+static int
+handle_coordinator(struct expdecay *query_stats, struct conn_info *conn)
+{
+	char buf[MAX_LINE];
+	(void)query_stats;
+
+	ssize_t len = read(conn->fd, buf, sizeof buf);
+	if (len == -1 && (errno == EINTR || errno == EAGAIN))
+		return 0;
+	if (len <= 0) {
+		fprintf(stderr, "agent: lost the coordinator, stopping\n");
+		unregister_service(conn);
+		close(conn->fd);
+		conn->fd = -1;
+		*coordinator_fd = -1;
+	}
+	*agent_stop = 1;
+	return 0;
+}
+
+void
+agent_watch(int *fd, volatile unsigned int *stop_now)
+{
+	agent_stop = stop_now;
+	coordinator_fd = fd;
+	coordinator.fd = *fd;
+	coordinator.handler = handle_coordinator;
+	coordinator.status = CONN_CONNECTED;
+	wait_for_service(&coordinator);
+}
+
+void
+agent_progress(int fd, unsigned long sent, unsigned long completed, double rate)
+{
+	char line[MAX_LINE];
+
+	snprintf(line, sizeof line, "P %lu %lu %.3f\n", sent, completed, rate);
+	send_line(fd, line);
+}
+
+static void
+put(struct dynbuf *b, const void *p, size_t len)
+{
+	dynbuf_ensure_space(b, len);
+	memcpy(b->buffer + b->pos, p, len);
+	b->pos += len;
+}
+
+#define PUT(b, v) put(b, &(v), sizeof (v))
+
+static void
+put_name(struct dynbuf *b, const char *name)
+{
+	uint32_t len = strlen(name);
+	PUT(b, len);
+	put(b, name, len);
+}
+
+void
+agent_report(int fd, unsigned long sent, double warmup, double measured,
+	     unsigned long warmup_sent)
+{
+	struct dynbuf b;
+	uint32_t magic = REPORT_MAGIC, histogram_size = sizeof (struct histogram);
+	uint32_t count = 0;
+	unsigned int n;
+	int code;
+	char line[MAX_LINE];
+
+	dynbuf_init(&b);
+	PUT(&b, magic);
+	PUT(&b, histogram_size);
+	PUT(&b, sent);
+	PUT(&b, warmup);
+	PUT(&b, measured);
+	PUT(&b, warmup_sent);
+	PUT(&b, run_stats.results);
+	PUT(&b, run_stats.warmup);
+	PUT(&b, run_stats.fastopen_attempted);
+	PUT(&b, run_stats.fastopen_used);
+	PUT(&b, run_stats.response_bytes);
+	PUT(&b, run_stats.status_codes);
+	PUT(&b, run_stats.latency);
+	PUT(&b, run_stats.latency_by_class);
+	for (code = 0; code < 600; code++)
+		count += run_stats.latency_by_status[code] != NULL;
+	PUT(&b, count);
+	for (code = 0; code < 600; code++) {
+		if (!run_stats.latency_by_status[code])
+			continue;
+		PUT(&b, code);
+		PUT(&b, *run_stats.latency_by_status[code]);
+	}
+
+	count = num_targets;
+	PUT(&b, count);
+	for (n = 0; n < num_targets; n++) {
+		const struct target *t = &targets[n];
+		put_name(&b, t->name);
+		PUT(&b, t->sent);
+		PUT(&b, t->completed);
+		PUT(&b, t->errors);
+		PUT(&b, t->latency);
+	}
+
+	count = num_groups;
+	PUT(&b, count);
+	for (n = 0; n < num_groups; n++) {
+		const struct group *g = &groups[n];
+		put_name(&b, g->name);
+		PUT(&b, g->sent);
+		PUT(&b, g->completed);
+		PUT(&b, g->errors);
+		PUT(&b, g->latency);
+	}
+
+	snprintf(line, sizeof line, "R %zu\n", b.pos);
+	send_line(fd, line);
+	send_all(fd, b.buffer, b.pos);
+	dynbuf_free(&b);
+}
+
+/* Coordinator */
+
+struct agent {
+	const char *address;
+	int fd;
+	struct dynbuf in;
+	unsigned long sent;
+	unsigned long completed;
+	double rate;
+	double warmup; /* From the report */
+	double measured;
+	unsigned long warmup_sent;
+	int done;
+};
+
+struct report_reader {
+	const char *address;
+	const char *p;
+	const char *end;
+};
+
+static void
+get(struct report_reader *r, void *v, size_t len)
+{
+	if ((size_t)(r->end - r->p) < len) {
+		fprintf(stderr, "Truncated report from agent %s\n", r->address);
+		exit(EXIT_FAILURE);
+	}
+	memcpy(v, r->p, len);
+	r->p += len;
+}
+
+#define GET(r, v) get(r, &(v), sizeof (v))
+
+static void
+get_name(struct report_reader *r, char *name, size_t size)
+{
+	uint32_t len;
+	GET(r, len);
+	if (len >= size) {
+		fprintf(stderr, "Bad name in the report from agent %s\n", r->address);
+		exit(EXIT_FAILURE);
+	}
+	get(r, name, len);
+	name[len] = 0;
+}
+
+static void
+merge_phases(struct phase_latency *dst, const struct phase_latency *src)
+{
+	int phase;
+
+	for (phase = 0; phase < NUM_PHASES; phase++)
+		histogram_merge(&dst->phase[phase], &src->phase[phase]);
+}
+
+static struct target *
+target_named(const char *name)
+{
+	unsigned int n;
+
+	for (n = 0; n < num_targets; n++) {
+		if (strcmp(targets[n].name, name) == 0)
+			return &targets[n];
+	}
+	return target_add(NULL, NULL, name);
+}
+
+/* Add the report from an agent to ours, and return the number it sent */
+static unsigned long
+merge_report(struct agent *a, const char *buf, size_t len)
+{
+	const char *address = a->address;
+	struct report_reader r = { address, buf, buf + len };
+	/* Big, and only one report is merged at a time */
+	static struct run_stats in;
+	static struct histogram latency;
+	char name[NI_MAXHOST + NI_MAXSERV + 3];
+	uint32_t magic, histogram_size, count, n;
+	unsigned long sent, v;
+	int code, rc;
+
+	GET(&r, magic);
+	GET(&r, histogram_size);
+	if (magic != REPORT_MAGIC || histogram_size != sizeof (struct histogram)) {
+		fprintf(stderr, "Agent %s runs an incompatible cxbench\n", address);
+		exit(EXIT_FAILURE);
+	}
+	GET(&r, sent);
+	GET(&r, a->warmup);
+	GET(&r, a->measured);
+	GET(&r, a->warmup_sent);
+	GET(&r, in.results);
+	GET(&r, in.warmup);
+	GET(&r, in.fastopen_attempted);
+	GET(&r, in.fastopen_used);
+	GET(&r, in.response_bytes);
+	GET(&r, in.status_codes);
+	GET(&r, in.latency);
+	GET(&r, in.latency_by_class);
+
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++) {
+		run_stats.results[rc] += in.results[rc];
+		merge_phases(&run_stats.latency_by_class[rc], &in.latency_by_class[rc]);
+	}
+	run_stats.warmup += in.warmup;
+	run_stats.fastopen_attempted += in.fastopen_attempted;
+	run_stats.fastopen_used += in.fastopen_used;
+	run_stats.response_bytes += in.response_bytes;
+	for (code = 0; code < 600; code++)
+		run_stats.status_codes[code] += in.status_codes[code];
+	merge_phases(&run_stats.latency, &in.latency);
+
+	GET(&r, count);
+	for (n = 0; n < count; n++) {
+		GET(&r, code);
+		GET(&r, in.latency);
+		if (code < 100 || code >= 600) {
+			fprintf(stderr, "Bad status code in the report from agent %s\n", address);
+			exit(EXIT_FAILURE);
+		}
+		merge_phases(stats_latency_for_status(code), &in.latency);
+	}
+
+	GET(&r, count);
+	for (n = 0; n < count; n++) {
+		get_name(&r, name, sizeof name);
+		struct target *t = target_named(name);
+		GET(&r, v);
+		t->sent += v;
+		GET(&r, v);
+		t->completed += v;
+		GET(&r, v);
+		t->errors += v;
+		GET(&r, latency);
+		histogram_merge(&t->latency, &latency);
+	}
+
+	/* The coordinator has put the whole input in groups already, so the
+	   number of queries in each is known */
+	GET(&r, count);
+	for (n = 0; n < count; n++) {
+		get_name(&r, name, sizeof name);
+		struct group *g = group_named(name);
+		GET(&r, v);
+		g->sent += v;
+		GET(&r, v);
+		g->completed += v;
+		GET(&r, v);
+		g->errors += v;
+		GET(&r, latency);
+		histogram_merge(&g->latency, &latency);
+	}
+	return sent;
+}
+
+static int
+connect_agent(const char *address)
+{
+	struct addrinfo *ai = lookup_host(address);
+	if (!ai) {
+		fprintf(stderr, "Cannot resolve agent '%s'\n", address);
+		exit(EXIT_FAILURE);
+	}
+	int fd = socket(ai->ai_family, SOCK_STREAM, 0);
+	if (fd == -1 || connect(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
+		fprintf(stderr, "Cannot connect to agent %s: %s\n", address, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	freeaddrinfo(ai);
+	return fd;
+}
+
+static void
+send_job(struct agent *a, const char *token, const struct cluster_job *job,
+	 unsigned int index, const struct query *queries, size_t num_queries)
+{
+	struct dynbuf b;
+	size_t n, corpus_start;
+	int arg;
+
+	dynbuf_init(&b);
+	for (arg = 0; arg < job->argc; arg++)
+		put(&b, job->argv[arg], strlen(job->argv[arg]) + 1);
+	corpus_start = b.pos;
+	for (n = index; n < num_queries; n += job->num_agents) {
+		put(&b, queries[n].text, strlen(queries[n].text));
+		put(&b, "\n", 1);
+	}
+
+	char line[MAX_LINE];
+	snprintf(line, sizeof line, "JOB %s %u %u %llu %d %zu\n", token, index, job->num_agents,
+		 (unsigned long long)job->seed, job->argc, b.pos - corpus_start);
+	send_line(a->fd, line);
+	send_all(a->fd, b.buffer, b.pos);
+	dynbuf_free(&b);
+}
+
+/* Handle what has arrived from an agent. Returns -1 when it is gone. */
+static int
+agent_input(struct agent *a, unsigned long *sent)
+{
+	dynbuf_ensure_space(&a->in, 65536);
+	ssize_t len = read(a->fd, a->in.buffer + a->in.pos, 65536);
+	if (len == -1 && errno == EINTR)
+		return 0;
+	if (len <= 0) {
+		fprintf(stderr, "\nLost agent %s, its results are missing\n", a->address);
+		return -1;
+	}
+	a->in.pos += len;
+
+	while (a->in.pos) {
+		char *nl = memchr(a->in.buffer, '\n', a->in.pos);
+		if (!nl)
+			break;
+		*nl = 0;
+		size_t used = nl + 1 - a->in.buffer;
+		size_t report_len;
+		if (a->in.buffer[0] == 'P') {
+			sscanf(a->in.buffer, "P %lu %lu %lf", &a->sent, &a->completed, &a->rate);
+		} else if (sscanf(a->in.buffer, "R %zu", &report_len) == 1) {
+			if (a->in.pos - used < report_len) {
+				*nl = '\n'; /* Wait for the rest of it */
+				break;
+			}
+			*sent += merge_report(a, nl + 1, report_len);
+			used += report_len;
+			a->done = 1;
+		} else {
+			fprintf(stderr, "Unexpected '%s' from agent %s\n", a->in.buffer, a->address);
+			return -1;
+		}
+		memmove(a->in.buffer, a->in.buffer + used, a->in.pos - used);
+		a->in.pos -= used;
+	}
+	return 0;
+}
+
+unsigned long
+coordinate(const char *agent_list, const struct cluster_job *job,
+	   const struct query *queries, size_t num_queries,
+	   volatile unsigned int *stop_now, double *start, double *warmup_end,
+	   double *end, unsigned long *warmup_sent)
+{
+	struct agent *agents = NULL;
+	unsigned int num_agents = 0, n, running;
+	unsigned long sent = 0;
+	const char *token = cluster_token();
+	char *list = strdup(agent_list), *address, *save;
+
+	for (address = strtok_r(list, ",", &save); address; address = strtok_r(NULL, ",", &save)) {
+		agents = realloc(agents, (num_agents + 1) * sizeof agents[0]);
+		if (!agents) {
+			fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		memset(&agents[num_agents], 0, sizeof agents[0]);
+		agents[num_agents].address = address;
+		dynbuf_init(&agents[num_agents].in);
+		num_agents++;
+	}
+	if (num_agents != job->num_agents || num_queries < num_agents) {
+		fprintf(stderr, "Need at least one query for each of the %u agents\n", num_agents);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Hand out the jobs first, and start everybody once they have all loaded */
+	for (n = 0; n < num_agents; n++) {
+		agents[n].fd = connect_agent(agents[n].address);
+		send_job(&agents[n], token, job, n, queries, num_queries);
+	}
+	for (n = 0; n < num_agents; n++) {
+		char line[MAX_LINE];
+		recv_line(agents[n].fd, line, sizeof line);
+		if (strcmp(line, "READY") != 0) {
+			fprintf(stderr, "Agent %s is not ready: '%s'\n", agents[n].address, line);
+			exit(EXIT_FAILURE);
+		}
+	}
+	*start = now();
+	for (n = 0; n < num_agents; n++)
+		send_line(agents[n].fd, "GO\n");
+	fprintf(stderr, "Started %u agents\n", num_agents);
+
+	struct pollfd *fds = calloc(num_agents, sizeof fds[0]);
+	int stop_sent = 0;
+	double next_report = *start + 1;
+	running = num_agents;
+	while (running) {
+		if (*stop_now && !stop_sent) {
+			for (n = 0; n < num_agents; n++) {
+				if (agents[n].fd != -1)
+					send(agents[n].fd, "STOP\n", 5, MSG_NOSIGNAL);
+			}
+			stop_sent = 1;
+		}
+		for (n = 0; n < num_agents; n++) {
+			fds[n].fd = agents[n].fd;
+			fds[n].events = POLLIN;
+			fds[n].revents = 0;
+		}
+		double timeout = next_report - now();
+		if (poll(fds, num_agents, timeout > 0 ? (int)(timeout * 1e3) + 1 : 0) == -1
+		    && errno != EINTR) {
+			fprintf(stderr, "poll fails: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		for (n = 0; n < num_agents; n++) {
+			struct agent *a = &agents[n];
+			if (a->fd == -1 || !fds[n].revents)
+				continue;
+			if (agent_input(a, &sent) == -1 || a->done) {
+				close(a->fd);
+				a->fd = -1;
+				running--;
+			}
+		}
+		if (now() >= next_report) {
+			unsigned long total_sent = 0, total_completed = 0;
+			double rate = 0;
+			for (n = 0; n < num_agents; n++) {
+				total_sent += agents[n].sent;
+				total_completed += agents[n].completed;
+				rate += agents[n].rate;
+			}
+			printf("q: %10lu done: %10lu q/s: %9.7g  agents: %u/%u  \r", total_sent,
+			       total_completed, rate, running, num_agents);
+			fflush(stdout);
+			next_report += 1;
+		}
+	}
+	*end = now();
+	printf("\n");
+
+	/* The agents start a little after GO and end their warm-ups at
+	   different times, so their own clocks are better */
+	unsigned int reported = 0;
+	double warmup = 0, measured = 0;
+	*warmup_sent = 0;
+	for (n = 0; n < num_agents; n++) {
+		if (agents[n].done) {
+			warmup += agents[n].warmup;
+			measured += agents[n].measured;
+			*warmup_sent += agents[n].warmup_sent;
+			reported++;
+		}
+	}
+	*warmup_end = *start;
+	if (reported) {
+		*warmup_end += warmup / reported;
+		*end = *warmup_end + measured / reported;
+	}
+
+	for (n = 0; n < num_agents; n++)
+		dynbuf_free(&agents[n].in);
+	free(fds);
+	free(agents);
+	free(list);
+	return sent;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
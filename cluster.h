@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+
+/* Spread a run over several machines. Agents wait for a coordinator, which
+ * gives each of them its share of the queries and of the rate, and the
+ * command line to run them with. The agents start together when the
+ * coordinator says so, report progress every second, and send their
+ * counters and histograms back at the end to be merged. */
+
+#include <stdint.h>
+
+#include "dynbuf.h"
+
+struct query;
+
+struct cluster_job {
+	unsigned int index; /* Of this agent */
+	unsigned int num_agents;
+	uint64_t seed; /* For the whole run, each agent adds its index */
+	int argc;
+	char **argv;
+	struct dynbuf queries; /* This agent's share, one per line */
+};
+
+/* Agent side. agent_serve() accepts coordinators forever and only returns
+   in a child process, with the job and the socket to the coordinator. It
+   listens on an IPv4 address, NULL for loopback. */
+int agent_serve(const char *address, unsigned int port, struct cluster_job *);
+void agent_ready(int fd); /* Blocks until the coordinator says go */
+/* After init_wait(). Sets stop_now when the coordinator says STOP, and also
+   closes *fd and sets it to -1 if the coordinator goes away. */
+void agent_watch(int *fd, volatile unsigned int *stop_now);
+void agent_progress(int fd, unsigned long sent, unsigned long completed, double rate);
+/* The stats, targets and groups, how long the warm-up and the measurement
+   after it took, and the queries sent during the warm-up */
+void agent_report(int fd, unsigned long sent, double warmup, double measured,
+		  unsigned long warmup_sent);
+
+/* Coordinator side. agents is a comma separated list of host:port. The
+   merged results end up in run_stats, targets and groups. The warm-up and
+   the measurement last as long as they did on the agents on average, from
+   start, and warmup_sent is the sum sent during the warm-ups. */
+unsigned long coordinate(const char *agents, const struct cluster_job *,
+			 const struct query *queries, size_t num_queries,
+			 volatile unsigned int *stop_now, double *start, double *warmup_end,
+			 double *end, unsigned long *warmup_sent);
+
+#endif /* !CLUSTER_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/* cxbench-compile: turn a corpus of requests in JSON lines or HAR into the
+ * binary format --corpus maps, see corpus.h. JSON lines look like
+ *
+ *   {"method": "POST", "path": "/ingest", "headers": {"Content-Type": "application/json"},
+ *    "body": "{\"id\": 1}"}
+ *
+ * where everything but the path (or a full url) is optional, and headers
+ * can also be a list of [name, value] pairs. */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "corpus.h"
+#include "dynbuf.h"
+
+enum json_type { JSON_NULL, JSON_FALSE, JSON_TRUE, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+struct json {
+	enum json_type type;
+	char *string; /* Decoded string, or the text of a number */
+	size_t len;
+	char *key; /* For object members */
+	struct json *child; /* Arrays and objects */
+	struct json *next;
+};
+
+struct parser {
+	const char *p, *end;
+	const char *input_name;
+	unsigned int line;
+};
+
+struct request {
+	const char *method;
+	struct dynbuf path;
+	struct dynbuf head;
+	const char *body;
+	size_t body_len;
+};
+
+static unsigned long skipped;
+
+static void *
+xmalloc(size_t size)
+{
+	void *p = malloc(size);
+	if (!p) {
+		fprintf(stderr, "malloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void
+parse_error(struct parser *ps, const char *what)
+{
+	fprintf(stderr, "%s:%u: %s\n", ps->input_name, ps->line, what);
+	exit(EXIT_FAILURE);
+}
+
+static void
+skip_space(struct parser *ps)
+{
+	for (; ps->p < ps->end; ps->p++) {
+		if (*ps->p == '\n')
+			ps->line++;
+		else if (*ps->p != ' ' && *ps->p != '\t' && *ps->p != '\r')
+			break;
+	}
+}
+
+static void
+put_utf8(struct dynbuf *d, uint32_t c)
+{
+	dynbuf_ensure_space(d, 4);
+	char *o = d->buffer + d->pos;
+	if (c < 0x80) {
+		o[0] = c;
+		d->pos += 1;
+	} else if (c < 0x800) {
+		o[0] = 0xc0 | (c >> 6);
+		o[1] = 0x80 | (c & 0x3f);
+		d->pos += 2;
+	} else if (c < 0x10000) {
+		o[0] = 0xe0 | (c >> 12);
+		o[1] = 0x80 | ((c >> 6) & 0x3f);
+		o[2] = 0x80 | (c & 0x3f);
+		d->pos += 3;
+	} else {
+		o[0] = 0xf0 | (c >> 18);
+		o[1] = 0x80 | ((c >> 12) & 0x3f);
+		o[2] = 0x80 | ((c >> 6) & 0x3f);
+		o[3] = 0x80 | (c & 0x3f);
+		d->pos += 4;
+	}
+}
+
+static uint32_t
+parse_hex4(struct parser *ps)
+{
+	uint32_t c = 0;
+	int n;
+
+	if (ps->end - ps->p < 4)
+		parse_error(ps, "truncated \\u escape");
+	for (n = 0; n < 4; n++) {
+		char h = *ps->p++;
+		c <<= 4;
+		if (h >= '0' && h <= '9')
+			c |= h - '0';
+		else if ((h | 0x20) >= 'a' && (h | 0x20) <= 'f')
+			c |= (h | 0x20) - 'a' + 10;
+		else
+			parse_error(ps, "bad \\u escape");
+	}
+	return c;
+}
+
+/* After the opening quote. The result is NUL terminated. */
+static char *
+parse_string(struct parser *ps, size_t *len)
+{
+	struct dynbuf d;
+
+	dynbuf_init(&d);
+	for (;;) {
+		if (ps->p >= ps->end)
+			parse_error(ps, "unterminated string");
+		char c = *ps->p++;
+		if (c == '"')
+			break;
+		if (c == '\n')
+			parse_error(ps, "newline in string");
+		if (c != '\\') {
+			dynbuf_ensure_space(&d, 1);
+			d.buffer[d.pos++] = c;
+			continue;
+		}
+		if (ps->p >= ps->end)
+			parse_error(ps, "unterminated string");
+		c = *ps->p++;
+		switch (c) {
+		case 'b': c = '\b'; break;
+		case 'f': c = '\f'; break;
+		case 'n': c = '\n'; break;
+		case 'r': c = '\r'; break;
+		case 't': c = '\t'; break;
+		case '"': case '\\': case '/': break;
+		case 'u': {
+			uint32_t u = parse_hex4(ps);
+			if (u >= 0xd800 && u < 0xdc00 && ps->end - ps->p >= 6
+			    && ps->p[0] == '\\' && ps->p[1] == 'u') {
+				ps->p += 2;
+				uint32_t low = parse_hex4(ps);
+				if (low < 0xdc00 || low >= 0xe000)
+					parse_error(ps, "bad surrogate pair");
+				u = 0x10000 + ((u - 0xd800) << 10) + (low - 0xdc00);
+			}
+			put_utf8(&d, u);
+			continue;
+		}
+		default:
+			parse_error(ps, "bad escape in string");
+		}
+		dynbuf_ensure_space(&d, 1);
+		d.buffer[d.pos++] = c;
+	}
+	dynbuf_ensure_space(&d, 1);
+	d.buffer[d.pos] = 0;
+	*len = d.pos;
+	return d.buffer;
+}
+
+static int
+consume(struct parser *ps, const char *word)
+{
+	size_t len = strlen(word);
+	if ((size_t)(ps->end - ps->p) < len || memcmp(ps->p, word, len))
+		return 0;
+	ps->p += len;
+	return 1;
+}
+
+static struct json *
+parse_value(struct parser *ps)
+{
+	struct json *v = xmalloc(sizeof *v);
+	memset(v, 0, sizeof *v);
+
+	skip_space(ps);
+	if (ps->p >= ps->end)
+		parse_error(ps, "unexpected end of input");
+	switch (*ps->p) {
+	case '{':
+	case '[': {
+		char close = *ps->p == '{' ? '}' : ']';
+		struct json **tail = &v->child;
+		v->type = close == '}' ? JSON_OBJECT : JSON_ARRAY;
+		ps->p++;
+		skip_space(ps);
+		if (ps->p < ps->end && *ps->p == close) {
+			ps->p++;
+			return v;
+		}
+		for (;;) {
+			char *key = NULL;
+			size_t key_len;
+			if (v->type == JSON_OBJECT) {
+				skip_space(ps);
+				if (ps->p >= ps->end || *ps->p != '"')
+					parse_error(ps, "expected a member name");
+				ps->p++;
+				key = parse_string(ps, &key_len);
+				skip_space(ps);
+				if (ps->p >= ps->end || *ps->p++ != ':')
+					parse_error(ps, "expected ':'");
+			}
+			*tail = parse_value(ps);
+			(*tail)->key = key;
+			tail = &(*tail)->next;
+			skip_space(ps);
+			if (ps->p < ps->end && *ps->p == ',') {
+				ps->p++;
+				continue;
+			}
+			if (ps->p < ps->end && *ps->p == close) {
+				ps->p++;
+				return v;
+			}
+			parse_error(ps, v->type == JSON_OBJECT ? "expected ',' or '}'" : "expected ',' or ']'");
+		}
+	}
+	case '"':
+		ps->p++;
+		v->type = JSON_STRING;
+		v->string = parse_string(ps, &v->len);
+		return v;
+	default:
+		if (consume(ps, "null")) {
+			v->type = JSON_NULL;
+		} else if (consume(ps, "true")) {
+			v->type = JSON_TRUE;
+		} else if (consume(ps, "false")) {
+			v->type = JSON_FALSE;
+		} else {
+			const char *start = ps->p;
+			while (ps->p < ps->end && strchr("+-0123456789.eE", *ps->p))
+				ps->p++;
+			if (ps->p == start)
+				parse_error(ps, "unexpected character");
+			v->type = JSON_NUMBER;
+			v->len = ps->p - start;
+			v->string = xmalloc(v->len + 1);
+			memcpy(v->string, start, v->len);
+			v->string[v->len] = 0;
+		}
+		return v;
+	}
+}
+
+static void
+json_free(struct json *v)
+{
+	while (v) {
+		struct json *next = v->next;
+		json_free(v->child);
+		free(v->string);
+		free(v->key);
+		free(v);
+		v = next;
+	}
+}
+
+static const struct json *
+member(const struct json *v, const char *key)
+{
+	if (!v || v->type != JSON_OBJECT)
+		return NULL;
+	for (v = v->child; v; v = v->next) {
+		if (!strcmp(v->key, key))
+			return v;
+	}
+	return NULL;
+}
+
+static const char *
+string_member(const struct json *v, const char *key, size_t *len)
+{
+	v = member(v, key);
+	if (!v || v->type != JSON_STRING)
+		return NULL;
+	if (len)
+		*len = v->len;
+	return v->string;
+}
+
+/* Safe to put in a request line or a header */
+static int
+clean(const char *s, size_t len, int allow_space)
+{
+	size_t n;
+	for (n = 0; n < len; n++) {
+		if (s[n] == '\r' || s[n] == '\n' || s[n] == 0 || (!allow_space && s[n] == ' '))
+			return 0;
+	}
+	return len > 0;
+}
+
+/* Headers cxbench sends itself, or that only make sense in HTTP/2 */
+static int
+dropped_header(const char *name)
+{
+	return name[0] == ':' || !strcasecmp(name, "host") || !strcasecmp(name, "content-length")
+		|| !strcasecmp(name, "connection") || !strcasecmp(name, "transfer-encoding")
+		|| !strcasecmp(name, "keep-alive");
+}
+
+static int
+add_header(struct request *r, const char *name, const char *value)
+{
+	if (!name || !value)
+		return 0;
+	if (dropped_header(name))
+		return 1;
+	if (!clean(name, strlen(name), 0) || strchr(name, ':')
+	    || (*value && !clean(value, strlen(value), 1)))
+		return 0;
+	dynbuf_printf(&r->head, "%s: %s\r\n", name, value);
+	return 1;
+}
+
+/* headers as {"name": "value"}, [["name", "value"]] or HAR's
+   [{"name": ..., "value": ...}] */
+static int
+add_headers(struct request *r, const struct json *h)
+{
+	const struct json *e;
+
+	if (!h || h->type == JSON_NULL)
+		return 1;
+	for (e = h->child; e; e = e->next) {
+		int ok;
+		if (h->type == JSON_OBJECT && e->type == JSON_STRING)
+			ok = add_header(r, e->key, e->string);
+		else if (e->type == JSON_ARRAY && e->child && e->child->next
+			 && e->child->type == JSON_STRING && e->child->next->type == JSON_STRING)
+			ok = add_header(r, e->child->string, e->child->next->string);
+		else if (e->type == JSON_OBJECT)
+			ok = add_header(r, string_member(e, "name", NULL), string_member(e, "value", NULL));
+		else
+			ok = 0;
+		if (!ok)
+			return 0;
+	}
+	return h->type == JSON_OBJECT || h->type == JSON_ARRAY;
+}
+
+/* Fill in r from a request object, in JSON lines or HAR form. Returns 0 if
+   it cannot be sent as it is. */
+static int
+build_request(struct request *r, const struct json *req)
+{
+	size_t len;
+	const char *method = string_member(req, "method", NULL);
+	const char *path = string_member(req, "path", &len);
+
+	if (!path) {
+		const char *url = string_member(req, "url", NULL);
+		if (!url)
+			return 0;
+		/* Keep the path of absolute urls */
+		const char *scheme = strstr(url, "://");
+		if (scheme) {
+			url = strchr(scheme + 3, '/');
+			if (!url)
+				url = "/";
+		}
+		path = url;
+		len = strlen(url);
+	}
+	if (!method)
+		method = "GET";
+	if (!clean(method, strlen(method), 0) || !clean(path, len, 0))
+		return 0;
+
+	r->body = string_member(req, "body", &r->body_len);
+	if (!r->body)
+		r->body = string_member(member(req, "postData"), "text", &r->body_len);
+	if (!r->body)
+		r->body_len = 0;
+
+	r->path.pos = r->head.pos = 0;
+	dynbuf_ensure_space(&r->path, len + 1);
+	memcpy(r->path.buffer, path, len + 1);
+	r->path.pos = len + 1;
+	dynbuf_printf(&r->head, "%s %s HTTP/1.1\r\n", method, path);
+	if (!add_headers(r, member(req, "headers")))
+		return 0;
+	if (r->body_len || !strcmp(method, "POST") || !strcmp(method, "PUT")
+	    || !strcmp(method, "PATCH"))
+		dynbuf_printf(&r->head, "Content-Length: %zu\r\n", r->body_len);
+	return r->head.pos <= CORPUS_MAX_HEAD;
+}
+
+struct output {
+	FILE *f;
+	const char *name;
+	uint64_t pos;
+	struct corpus_entry *index;
+	size_t count, alloc;
+	unsigned long long body_bytes;
+	unsigned long with_body;
+};
+
+static uint64_t
+put(struct output *out, const void *data, size_t len)
+{
+	uint64_t at = out->pos;
+	if (len && fwrite(data, len, 1, out->f) != 1) {
+		fprintf(stderr, "Cannot write '%s': %s\n", out->name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	out->pos += len;
+	return at;
+}
+
+static void
+add_request(struct output *out, struct parser *ps, const struct json *req)
+{
+	static struct request r;
+
+	if (!build_request(&r, req)) {
+		fprintf(stderr, "%s:%u: skipping a request that cannot be sent as HTTP/1.1\n",
+			ps->input_name, ps->line);
+		skipped++;
+		return;
+	}
+	if (out->count == out->alloc) {
+		out->alloc = out->alloc ? 2 * out->alloc : 1024;
+		out->index = realloc(out->index, out->alloc * sizeof out->index[0]);
+		if (!out->index) {
+			fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+	struct corpus_entry *e = &out->index[out->count++];
+	memset(e, 0, sizeof *e);
+	e->path = put(out, r.path.buffer, r.path.pos);
+	e->head = put(out, r.head.buffer, r.head.pos);
+	e->head_len = r.head.pos;
+	e->body = put(out, r.body, r.body_len);
+	e->body_len = r.body_len;
+	if (r.body_len) {
+		out->with_body++;
+		out->body_bytes += r.body_len;
+	}
+}
+
+static void
+read_input(const char *name, struct dynbuf *in)
+{
+	FILE *f = strcmp(name, "-") ? fopen(name, "r") : stdin;
+	if (!f) {
+		fprintf(stderr, "Cannot open '%s': %s\n", name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	dynbuf_init(in);
+	for (;;) {
+		dynbuf_ensure_space(in, 65536);
+		size_t got = fread(in->buffer + in->pos, 1, 65536, f);
+		in->pos += got;
+		if (got < 65536)
+			break;
+	}
+	if (ferror(f)) {
+		fprintf(stderr, "Cannot read '%s': %s\n", name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if (f != stdin)
+		fclose(f);
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [-f jsonl|har] <input> <corpus>\n\n"
+		"Compile the requests in <input> (- for STDIN) into <corpus> for cxbench --corpus.\n"
+		" -f <format> : jsonl for one request object per line, har for a HAR capture.\n"
+		"   The default is har if the input is a single object with a \"log\", or jsonl\n\n"
+		"A jsonl request has a \"path\" or a \"url\", and optionally a \"method\" [GET],\n"
+		"\"headers\" as an object or a list of [name, value], and a \"body\" string.\n"
+		"Host, Connection and Content-Length are left out, cxbench sends its own.\n\n",
+		name);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *format = NULL;
+	int ch;
+
+	while ((ch = getopt(argc, argv, "hf:")) != -1) {
+		switch (ch) {
+		case 'f':
+			format = optarg;
+			if (strcmp(format, "jsonl") && strcmp(format, "har")) {
+				fprintf(stderr, "Unknown format '%s', use jsonl or har\n", format);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(EXIT_SUCCESS);
+		default:
+			usage(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (argc - optind != 2) {
+		usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	struct dynbuf in;
+	struct parser ps;
+	read_input(argv[optind], &in);
+	ps.p = in.buffer;
+	ps.end = in.buffer + in.pos;
+	ps.input_name = argv[optind];
+	ps.line = 1;
+
+	struct output out;
+	memset(&out, 0, sizeof out);
+	out.name = argv[optind + 1];
+	out.f = fopen(out.name, "w");
+	if (!out.f) {
+		fprintf(stderr, "Cannot open '%s' for writing: %s\n", out.name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	struct corpus_header header;
+	memset(&header, 0, sizeof header);
+	put(&out, &header, sizeof header); /* Filled in at the end */
+
+	for (;;) {
+		skip_space(&ps);
+		if (ps.p >= ps.end)
+			break;
+		struct json *v = parse_value(&ps);
+		const struct json *entries = member(member(v, "log"), "entries");
+		if (format ? !strcmp(format, "har") : entries != NULL) {
+			const struct json *e;
+			if (!entries || entries->type != JSON_ARRAY)
+				parse_error(&ps, "not a HAR file, there is no log.entries");
+			for (e = entries->child; e; e = e->next)
+				add_request(&out, &ps, member(e, "request"));
+		} else {
+			add_request(&out, &ps, v);
+		}
+		json_free(v);
+	}
+	if (!out.count) {
+		fprintf(stderr, "No requests in '%s'\n", argv[optind]);
+		exit(EXIT_FAILURE);
+	}
+
+	static const char zero[8];
+	put(&out, zero, -out.pos & 7);
+	memcpy(header.magic, CORPUS_MAGIC, sizeof header.magic);
+	header.byte_order = CORPUS_BYTE_ORDER;
+	header.count = out.count;
+	header.index_offset = put(&out, out.index, out.count * sizeof out.index[0]);
+	if (fseek(out.f, 0, SEEK_SET) == -1 || fwrite(&header, sizeof header, 1, out.f) != 1
+	    || fclose(out.f)) {
+		fprintf(stderr, "Cannot write '%s': %s\n", out.name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fprintf(stderr, "Compiled %zu requests, %lu with a body (%.1f MB), into '%s'",
+		out.count, out.with_body, out.body_bytes / 1e6, out.name);
+	if (skipped)
+		fprintf(stderr, ", skipped %lu", skipped);
+	fprintf(stderr, "\n");
+	return EXIT_SUCCESS;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -18,10 +18,32 @@
  *
  */
 
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdint.h>
+
 #include "dynbuf.h"
+#include "http-response.h"
+#include "stats.h"
+#include "xxh64.h"
 
 struct conn_info;
 struct expdecay;
+struct target;
+struct h2_conn;
+struct addrinfo;
+struct body_file;
+struct template;
+
+/* A query from the input, classified once when it is read */
+struct query {
+	const char *text;
+	unsigned int group; /* Index in groups, see group.h */
+	const struct body_file *body; /* For @<path> with --use-post, see body-file.h */
+	const char *request; /* Request line and headers from a --corpus, see corpus.h */
+	unsigned int request_len;
+	const struct template *tmpl; /* text is a --template, see template.h */
+};
 
 typedef int (*event_handler)(struct expdecay *, struct conn_info *);
 
@@ -29,6 +51,7 @@ enum conn_info_status {
 	CONN_UNUSED = 0, /* Should be 0 for easy memset cleaning of all statuses */
 	CONN_CONNECTING,
 	CONN_CONNECTED,
+	CONN_HANDSHAKING,
 	CONN_WAITING_RESULT,
 	CONN_MORE_RESULTS
 };
@@ -36,22 +59,45 @@ enum conn_info_status {
 struct conn_info {
 	double connect_time;
 	double connected_time;
+	double handshake_time; /* TLS handshake done */
 	double first_result_time;
 	double finished_result_time;
 
-	const char *query;
-	const struct addrinfo *target;
-	const char *hostname;
+	const struct query *query;
+	struct target *target;
 	event_handler handler;
 	unsigned int pending_index;
+	int read_registered; /* Poller private, see wait_for_connected_then_read() */
 	enum conn_info_status status;
 	int fd;
+	void *tls; /* SSL * when using TLS */
+	int tls_resumed;
+	int fastopen; /* TCP Fast Open was requested for the socket */
+	int connect_deferred; /* connect() returned at once, the SYN goes out with the first write */
+	int warmup; /* Sent during the warm-up, left out of the statistics */
+	off_t body_offset; /* How much of a body file has been sent */
+	uint64_t instance; /* Which expansion of a template query */
+	struct h2_conn *h2; /* The HTTP/2 connection state for a h2c socket */
 
 	struct dynbuf data;
+	size_t sunk_bytes; /* Body bytes thrown away by --bandwidth, not in data */
+	struct http_response response;
+	struct xxh64 body_hash; /* For --record-hashes and --verify-hashes */
+	size_t hashed; /* How far into data body_hash has got */
 };
 
 extern struct conn_info *connection_info;
 
+/* Provided by cxbench.c */
+struct addrinfo *lookup_host(const char *address); /* host:port or unix:<path> */
+struct conn_info *open_connection(struct target *target); /* NULL if connect fails */
+void query_done(struct expdecay *query_stats, struct conn_info *conn, int http_result_code);
+void query_failed(struct conn_info *conn, enum result_class result);
+/* Anything kept open besides the connections must stay out of the range of
+   fds that index connection_info. These move fd, or the file, above it. */
+int fd_above_connections(int fd);
+FILE *fopen_above_connections(const char *filename, const char *mode);
+
 
 #endif /* !CONNECTION_INFO_H */
 
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "corpus.h"
+#include "connection-info.h"
+#include "body-file.h"
+
+static void
+corrupt(const char *filename, const char *why)
+{
+	fprintf(stderr, "'%s' is not a usable corpus: %s\n", filename, why);
+	exit(EXIT_FAILURE);
+}
+
+size_t
+corpus_load(const char *filename, int min_fd, struct query **queries)
+{
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st) == -1) {
+		fprintf(stderr, "Cannot open corpus '%s': %s\n", filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	if ((size_t)st.st_size < sizeof(struct corpus_header))
+		corrupt(filename, "too short");
+	const char *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (base == MAP_FAILED) {
+		fprintf(stderr, "Cannot map corpus '%s': %s\n", filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	const struct corpus_header *h = (const struct corpus_header *)base;
+	uint64_t size = st.st_size;
+	if (memcmp(h->magic, CORPUS_MAGIC, sizeof h->magic))
+		corrupt(filename, "no cxbench-compile header");
+	if (h->byte_order != CORPUS_BYTE_ORDER)
+		corrupt(filename, "compiled on a machine with the other byte order");
+	if (!h->count || h->index_offset % 8 || h->index_offset > size
+	    || (size - h->index_offset) / sizeof(struct corpus_entry) < h->count)
+		corrupt(filename, "the index is missing or truncated");
+
+	/* Check every entry now, so sending needs no checks */
+	const struct corpus_entry *index = (const struct corpus_entry *)(base + h->index_offset);
+	struct query *q = calloc(h->count, sizeof q[0]);
+	struct body_file *bodies = calloc(h->count, sizeof bodies[0]);
+	int body_fd = -1;
+	uint32_t n;
+	if (!q || !bodies) {
+		fprintf(stderr, "Cannot allocate %u queries: %s\n", h->count, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	for (n = 0; n < h->count; n++) {
+		const struct corpus_entry *e = &index[n];
+		if (e->path >= h->index_offset
+		    || !memchr(base + e->path, 0, h->index_offset - e->path)
+		    || e->head > h->index_offset || e->head_len > CORPUS_MAX_HEAD
+		    || e->head_len > h->index_offset - e->head
+		    || e->body > h->index_offset || e->body_len > h->index_offset - e->body)
+			corrupt(filename, "an entry points outside the data");
+		q[n].text = base + e->path;
+		q[n].request = base + e->head;
+		q[n].request_len = e->head_len;
+		if (!e->body_len)
+			continue;
+		if (body_fd == -1) {
+			/* Bodies are sent from the page cache, like body files */
+			body_fd = fcntl(fd, F_DUPFD_CLOEXEC, min_fd);
+			if (body_fd == -1) {
+				fprintf(stderr, "Cannot keep corpus '%s' open: %s\n", filename,
+					strerror(errno));
+				exit(EXIT_FAILURE);
+			}
+		}
+		bodies[n].path = filename;
+		bodies[n].fd = body_fd;
+		bodies[n].offset = e->body;
+		bodies[n].size = e->body_len;
+		q[n].body = &bodies[n];
+	}
+	close(fd);
+
+	*queries = q;
+	return h->count;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+/* A request corpus compiled by cxbench-compile, for --corpus. Every
+ * request has its own method, headers and body, rendered ahead of time so
+ * cxbench only has to add the Host header. The file is mmap'ed as it is,
+ * so it is in the byte order of the machine that compiled it.
+ *
+ * Layout: a corpus_header, the data (paths, heads and bodies), and then
+ * the index of count corpus_entry at index_offset. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CORPUS_MAGIC "CXCORP01"
+#define CORPUS_BYTE_ORDER 0x01020304u
+
+/* The head is copied into the send buffer together with the Host header */
+enum { CORPUS_MAX_HEAD = 16000 };
+
+struct corpus_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t count;
+	uint64_t index_offset;
+};
+
+struct corpus_entry {
+	uint64_t path;     /* NUL terminated, for the query log and --group-by */
+	uint64_t head;     /* Request line and headers, each ending in CRLF */
+	uint64_t body;
+	uint64_t body_len;
+	uint32_t head_len;
+	uint32_t reserved;
+};
+
+struct query;
+
+/* Map filename and return its requests as queries. The file descriptor
+   for sending the bodies is moved to min_fd or above. */
+size_t corpus_load(const char *filename, int min_fd, struct query **queries);
+
+#endif /* !CORPUS_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -22,8 +22,6 @@
  *
  */
 
-#warning TODO: ADD regex support for parsing results?
-
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -32,12 +30,17 @@
 #include <getopt.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stddef.h>
 #include <netdb.h>
 #include <errno.h>
 #include <math.h>
 #include <fcntl.h>
 #include <signal.h>
 #include <time.h>
+#include <stdint.h>
 
 #include "dynbuf.h"
 #include "debug.h"
@@ -45,25 +48,57 @@
 #include "connection-info.h"
 #include "timeutil.h"
 #include "expdecay.h"
+#include "rng.h"
+#include "match.h"
+#include "stats.h"
+#include "target.h"
+#include "tls.h"
+#include "h2.h"
+#include "local-address.h"
+#include "syscall-stats.h"
+#include "body-sink.h"
+#include "metrics.h"
+#include "summary.h"
+#include "group.h"
+#include "cluster.h"
+#include "loop-stats.h"
+#include "interval-log.h"
+#include "warmup.h"
+#include "body-file.h"
+#include "corpus.h"
+#include "template.h"
+#include "popularity.h"
+#include "response-hash.h"
 
 static void usage(const char *name);
-struct addrinfo *lookup_host(const char *address);
 static void print_addresses(const struct addrinfo *ai);
 static void parse_arguments(int argc, char **argv);
 const struct addrinfo *select_address(const struct addrinfo *addr);
 static int lookup_addrinfo(const struct addrinfo *, char *host, size_t hostlen, char *port, size_t portlen);
-static void run_benchmark(const char *hostname, const struct addrinfo *addr);
+static void add_targets(const char *address);
+static void run_benchmark(void);
+static void run_coordinator(int argc, char **argv);
+static void parse_job_arguments(int argc, char **argv);
+static void parse_rate_windows(const char *list);
+static void open_logs(void);
+static void read_corpus(void);
 static void read_queries(void);
 static void randomize_query_list();
-static void initiate_query(const char *hostname, const struct addrinfo *target, const char *query);
+static void initiate_query(struct target *target, const struct query *query);
+static void close_query(struct conn_info *conn);
 
-typedef const char *(*query_function)(void);
+typedef const struct query *(*query_function)(void);
 query_function select_query_function(void);
-static const char *next_random_query(void);
-static const char *next_loop_query(void);
-static const char *next_query_noloop(void);
+static const struct query *next_random_query(void);
+static const struct query *next_popular_query(void);
+static const struct query *next_loop_query(void);
+static const struct query *next_query_noloop(void);
 
 static int handle_connected(struct expdecay *, struct conn_info *);
+static int handle_handshake(struct expdecay *, struct conn_info *);
+static int send_query(struct conn_info *);
+static int send_body(struct conn_info *);
+static int handle_body_writable(struct expdecay *, struct conn_info *);
 static int handle_readable(struct expdecay *, struct conn_info *);
 
 static int parse_http_result_code(const char *buf, size_t len);
@@ -72,7 +107,10 @@ static char *find_char_or_end(const char *buf, char needle, const char *end);
 static void signal_handler(int signal);
 static int sig_permanent(int sig, void (*handler)(int));
 static void report_progress(struct expdecay *query_stats);
+static void report_bandwidth(FILE *);
 static void report_pending(void);
+static unsigned int queries_in_flight(void);
+static int can_send_query(void);
 
 typedef double (*waiter_fn)(double);
 
@@ -80,61 +118,341 @@ static double poisson_wait(double interval);
 static double regular_wait(double interval);
 static waiter_fn waiter = poisson_wait;
 
+static struct rng rng;
+static uint64_t rng_seed;
+static int rng_seed_given = 0;
+
 static volatile unsigned int stop_now = 0;
 static int loop_mode = 0;
 static int random_mode = 0;
 static int use_post = 0;
+static int all_addresses = 0;
+static int use_tls = 0;
+static int tls_resume = 0;
+static int use_ktls = 0;
+static int use_h2 = 0;
+static int use_fastopen = 0;
+static int use_linger0 = 0;
+static int lean = 0;
+static int bandwidth_mode = 0;
+static unsigned int metrics_port = 0;
+static const char *metrics_address = NULL; /* Loopback unless given */
+static double run_start, run_end;
+/* Smoothed completion rates for the progress line, over these windows in
+   seconds. The first one also goes to the metrics and the coordinator. */
+enum { MAX_RATE_WINDOWS = 4 };
+static double rate_window[MAX_RATE_WINDOWS] = { 1, 10, 60 };
+static unsigned int num_rate_windows = 3;
+static struct expdecay rate[MAX_RATE_WINDOWS];
+static unsigned int h2_connections = 1;
+static uint32_t h2_window = 1 << 20;
+static enum balance_mode balance_mode = BALANCE_ROUND_ROBIN;
 static unsigned int num_parallell = 1;
 static const char *query_prefix = "";
 static const char *header = "Dummy: dummy";
 static const char *output_filename = "cxbench.out";
 static const char *error_filename = "cxbench.errors";
+static const char *summary_filename = NULL;
+static const char *interval_log_filename = NULL;
+static const char *corpus_filename = NULL;
+static int use_templates = 0;
+static const char *distribution = NULL;
+static const char *record_hashes = NULL;
+static const char *verify_hashes = NULL;
+static const char *coordinator_agents = NULL;
+static unsigned int agent_port = 0;
+static const char *agent_address = NULL; /* Loopback unless given */
+static int agent_fd = -1; /* To the coordinator, when running as an agent */
+static struct cluster_job job;
 static FILE *querylog_file;
 static FILE *error_file;
 static unsigned long queries_sent = 0;
 static unsigned long max_queries = 0;
 static double query_interval = 0;
 static double time_of_next_query = 0;
+static struct matcher *response_matcher = NULL;
+static size_t num_queries = 0;
+struct dynbuf queries;
+static struct query *query_list = 0;
+
+enum { MAX_FD_HEADROOM = 20 };
+static unsigned int connection_fds; /* Connections get the fds below this */
 
 int
 main(int argc, char **argv)
 {
 	parse_arguments(argc, argv);
-	querylog_file = fopen(output_filename, "a");
+	if (agent_port) {
+		/* Only returns in a child process, with a job from a coordinator */
+		agent_fd = agent_serve(agent_address, agent_port, &job);
+		argc = job.argc;
+		argv = job.argv;
+		parse_job_arguments(argc, argv);
+	}
+	connection_fds = num_parallell + MAX_FD_HEADROOM;
+	if (agent_fd != -1)
+		agent_fd = fd_above_connections(agent_fd);
+
+	sig_permanent(SIGINT, signal_handler);
+	if (!rng_seed_given)
+		rng_seed = rng_default_seed();
+	fprintf(stderr, "Random seed: %llu\n", (unsigned long long)rng_seed);
+
+	struct summary_params summary = {
+		.argc = argc,
+		.argv = argv,
+		.parallel = num_parallell,
+		.offered_qps = query_interval ? 1.0 / query_interval : 0,
+		.max_queries = max_queries,
+		.wait_mode = waiter == poisson_wait ? "poisson" : "regular",
+		.protocol = use_h2 ? "h2c" : "http/1.1",
+		.query_prefix = query_prefix,
+		.loop = loop_mode,
+		.randomize = random_mode,
+		.distribution = distribution,
+		.tls = use_tls,
+		.seed = rng_seed,
+	};
+
+	if (coordinator_agents) {
+		run_coordinator(argc, argv);
+	} else {
+		open_logs();
+		rng_init(&rng, rng_seed);
+		if (record_hashes)
+			response_hash_record(record_hashes);
+		if (verify_hashes)
+			response_hash_verify(verify_hashes);
+
+		int n;
+		for (n = optind; n < argc; n++)
+			add_targets(argv[n]);
+		local_address_report(stderr);
+
+		if (use_tls)
+			tls_init(tls_resume, use_ktls);
+		if (use_h2)
+			h2_init(h2_connections, num_parallell, h2_window, query_prefix, header,
+				use_post);
+
+		run_benchmark();
+	}
+	stats_print(stderr);
+	stats_print_latency(stderr);
+	warmup_report(stderr);
+	if (!coordinator_agents) {
+		syscall_report(stderr, stats_total());
+		loop_stats_report(stderr, run_end - run_start);
+	}
+	if (bandwidth_mode)
+		report_bandwidth(stderr);
+	if (use_tls && !coordinator_agents)
+		tls_report(stderr);
+	if (hashing_responses) {
+		response_hash_finish();
+		response_hash_report(stderr);
+	}
+	if (num_targets > 1)
+		target_report(stderr);
+	if (num_groups)
+		group_report(stderr);
+	if (agent_fd != -1)
+		agent_report(agent_fd, queries_sent - warmup_queries(), warmup_end() - run_start,
+			     run_end - warmup_end(), warmup_queries());
+	if (summary_filename) {
+		summary.start = warmup_end();
+		summary.end = run_end;
+		summary.sent = queries_sent - warmup_queries();
+		summary.warmup = warmup_end() - run_start;
+		summary.warmup_sent = warmup_queries();
+		summary_write(summary_filename, &summary);
+	}
+	exit(EXIT_SUCCESS);
+}
+
+/* [<address>:]<port>, the address is left alone unless given */
+static void
+parse_listen_address(const char *what, const char *arg, const char **address,
+		     unsigned int *port)
+{
+	const char *p = strrchr(arg, ':');
+	char *end;
+
+	if (p) {
+		*address = strndup(arg, p - arg);
+		p++;
+	} else {
+		p = arg;
+	}
+	*port = strtoul(p, &end, 10);
+	if (*end || *port == 0 || *port > 65535) {
+		fprintf(stderr, "Invalid %s port '%s'\n", what, arg);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void
+parse_rate_windows(const char *list)
+{
+	const char *p = list;
+	num_rate_windows = 0;
+	do {
+		char *end;
+		double window = strtod(p, &end);
+		if (end == p || (*end && *end != ',') || !(window > 0)
+		    || num_rate_windows == MAX_RATE_WINDOWS) {
+			fprintf(stderr, "Invalid rate windows '%s', give up to %d windows in "
+				"seconds like 1,10,60\n", list, MAX_RATE_WINDOWS);
+			exit(EXIT_FAILURE);
+		}
+		rate_window[num_rate_windows++] = window;
+		p = *end ? end + 1 : end;
+	} while (*p);
+}
+
+static void
+open_logs(void)
+{
+	querylog_file = fopen_above_connections(output_filename, "a");
 	if (!querylog_file) {
 		fprintf(stderr, "Cannot open '%s' for appending: %s\n", output_filename,
 			strerror(errno));
 		exit(EXIT_FAILURE);
 	}
-	error_file = fopen(error_filename, "a");
+	error_file = fopen_above_connections(error_filename, "a");
 	if (!error_file) {
 		fprintf(stderr, "Cannot open '%s' for appending: %s\n", error_filename,
 			strerror(errno));
 		exit(EXIT_FAILURE);
 	}
+}
 
-	sig_permanent(SIGINT, signal_handler);
-	srand48(time(0) + getpid() * 131);
+/* Append the agent number to a log file name, so agents sharing a directory
+   do not write over each other */
+static const char *
+agent_filename(const char *name)
+{
+	size_t len = strlen(name) + 16;
+	char *agent_name = malloc(len);
+	if (!agent_name) {
+		fprintf(stderr, "malloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	snprintf(agent_name, len, "%s.%u", name, job.index + 1);
+	return agent_name;
+}
 
-	argc -= optind;
-	argv += optind;
+/* An agent runs command lines from the network, so the files they name must
+   be in its working directory */
+static void
+agent_check_file(const char *what, const char *name)
+{
+	if (agent_fd != -1 && name && strchr(name, '/')) {
+		fprintf(stderr, "agent: %s '%s' is not a file in the working directory\n", what,
+			name);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* An agent runs with the command line of the coordinator, and its share of
+   the rate and of the number of queries */
+static void
+parse_job_arguments(int argc, char **argv)
+{
+#ifdef __GLIBC__
+	optind = 0; /* Also resets the internal state of getopt */
+#else
+	optreset = 1;
+	optind = 1;
+#endif
+	parse_arguments(argc, argv);
+	coordinator_agents = NULL;
+	summary_filename = NULL;
+	metrics_port = 0;
+	agent_check_file("--output", output_filename);
+	agent_check_file("--errors", error_filename);
+	agent_check_file("--interval-log", interval_log_filename);
+	agent_check_file("--corpus", corpus_filename);
+	agent_check_file("--record-hashes", record_hashes);
+	agent_check_file("--verify-hashes", verify_hashes);
+	int n;
+	for (n = optind; n < argc; n++) {
+		if (!strncmp(argv[n], "unix:", 5))
+			agent_check_file("unix socket", argv[n] + 5);
+	}
+	if (use_templates)
+		template_confine();
+	query_interval *= job.num_agents;
+	if (max_queries) {
+		max_queries = max_queries / job.num_agents
+			+ (job.index < max_queries % job.num_agents);
+	}
+	rng_seed = job.seed + job.index;
+	rng_seed_given = 1;
+	output_filename = agent_filename(output_filename);
+	error_filename = agent_filename(error_filename);
+	if (interval_log_filename)
+		interval_log_filename = agent_filename(interval_log_filename);
+}
 
-	struct addrinfo *res = lookup_host(argv[0]);
+static void
+run_coordinator(int argc, char **argv)
+{
+	const char *p;
+
+	job.num_agents = 1;
+	for (p = coordinator_agents; *p; p++)
+		job.num_agents += *p == ',';
+	if (max_queries && max_queries < job.num_agents) {
+		fprintf(stderr, "Need at least one query for each of the %u agents\n",
+			job.num_agents);
+		exit(EXIT_FAILURE);
+	}
+	job.seed = rng_seed;
+	job.argc = argc;
+	job.argv = argv;
+	read_queries();
+	double measure_start;
+	unsigned long warmup_sent;
+	queries_sent = coordinate(coordinator_agents, &job, query_list, num_queries, &stop_now,
+				  &run_start, &measure_start, &run_end, &warmup_sent);
+	/* The agents left out their own warm-ups */
+	warmup_start(run_start);
+	warmup_merged(measure_start, warmup_sent);
+	queries_sent += warmup_sent;
+}
+
+static void
+add_targets(const char *address)
+{
+	/* The addrinfo list is never freed, the targets point into it */
+	struct addrinfo *res = lookup_host(address);
 	if (!res) {
-		fprintf(stderr, "Host lookup failed.");
+		fprintf(stderr, "Host lookup failed.\n");
 		exit(EXIT_FAILURE);
 	}
 	print_addresses(res);
 
-	const struct addrinfo *target = select_address(res);
-	if (!target) {
-		fprintf(stderr, "Cannot connect to benchmark server, aborting.\n");
+	const struct addrinfo *ai = select_address(res);
+	if (!ai) {
+		fprintf(stderr, "Cannot connect to benchmark server %s, aborting.\n", address);
 		exit(EXIT_FAILURE);
 	}
-
-	run_benchmark(argv[0], target);
-	freeaddrinfo(res);
-	exit(EXIT_SUCCESS);
+	for (; ai; ai = select_address(ai->ai_next)) {
+		char host[NI_MAXHOST];
+		char port[NI_MAXSERV];
+		char name[NI_MAXHOST + NI_MAXSERV + 3];
+		lookup_addrinfo(ai, host, sizeof host, port, sizeof port);
+		if (ai->ai_family == AF_UNIX)
+			snprintf(name, sizeof name, "unix:%s", host);
+		else
+			snprintf(name, sizeof name, ai->ai_family == AF_INET6 ? "[%s]:%s" : "%s:%s",
+				 host, port);
+		/* The Host header needs something sensible for socket paths */
+		target_add(ai, ai->ai_family == AF_UNIX ? "localhost" : address, name);
+		if (!all_addresses)
+			break;
+	}
 }
 
 const struct addrinfo *
@@ -153,7 +471,15 @@ select_address(const struct addrinfo *ai)
 		char host[NI_MAXHOST];
 		char port[NI_MAXSERV];
 		lookup_addrinfo(ai, host, sizeof host, port, sizeof port);
-		fprintf(stderr, "Testing connection to %s:%s...\n", host, port);
+		if (local_address_bind(fd, ai->ai_family) == -1) {
+			fprintf(stderr, "Cannot bind local address for %s: %s\n", host, strerror(errno));
+			close(fd);
+			continue;
+		}
+		if (ai->ai_family == AF_UNIX)
+			fprintf(stderr, "Testing connection to unix:%s...\n", host);
+		else
+			fprintf(stderr, "Testing connection to %s:%s...\n", host, port);
 
 		double t1 = now();
 		int connect_status = connect(fd, ai->ai_addr, ai->ai_addrlen);
@@ -175,7 +501,14 @@ select_address(const struct addrinfo *ai)
 static int
 lookup_addrinfo(const struct addrinfo *ai, char *host, size_t hostlen, char *port, size_t portlen)
 {
-	
+	if (ai->ai_family == AF_UNIX) {
+		/* The path is the host, there is no port */
+		const struct sockaddr_un *sun = (const struct sockaddr_un *)ai->ai_addr;
+		snprintf(host, hostlen, "%s", sun->sun_path);
+		snprintf(port, portlen, "%s", "");
+		return 0;
+	}
+
 	int error = getnameinfo(ai->ai_addr, ai->ai_addrlen, host, hostlen,
 				port, portlen, NI_NUMERICHOST | NI_NUMERICSERV);
 	if (error) {
@@ -188,6 +521,49 @@ lookup_addrinfo(const struct addrinfo *ai, char *host, size_t hostlen, char *por
 	return error;
 }
 
+static void
+add_match_rule(const char *pattern, enum match_kind kind, int is_regex)
+{
+	if (!response_matcher)
+		response_matcher = matcher_new();
+	matcher_add(response_matcher, pattern, kind, is_regex);
+}
+
+enum {
+	/* Long options without a short equivalent */
+	OPT_EXPECT = 256,
+	OPT_REJECT,
+	OPT_EXPECT_REGEX,
+	OPT_REJECT_REGEX,
+	OPT_ALL_ADDRESSES,
+	OPT_BALANCE,
+	OPT_TLS,
+	OPT_TLS_RESUME,
+	OPT_KTLS,
+	OPT_HTTP2,
+	OPT_H2_CONNECTIONS,
+	OPT_H2_WINDOW,
+	OPT_BIND_ADDRESSES,
+	OPT_LOCAL_PORTS,
+	OPT_FASTOPEN,
+	OPT_LINGER0,
+	OPT_LEAN,
+	OPT_BANDWIDTH,
+	OPT_METRICS_PORT,
+	OPT_SUMMARY,
+	OPT_GROUP_BY,
+	OPT_INTERVAL_LOG,
+	OPT_RATE_WINDOWS,
+	OPT_WARMUP,
+	OPT_CORPUS,
+	OPT_TEMPLATE,
+	OPT_DISTRIBUTION,
+	OPT_RECORD_HASHES,
+	OPT_VERIFY_HASHES,
+	OPT_AGENT,
+	OPT_COORDINATOR,
+};
+
 static void
 parse_arguments(int argc, char **argv)
 {
@@ -205,11 +581,43 @@ parse_arguments(int argc, char **argv)
 		{ "qps", required_argument, NULL, 's' },
 		{ "num-queries", required_argument, NULL, 'n' },
 		{ "wait-mode", required_argument, NULL, 'w' },
+		{ "seed", required_argument, NULL, 'S' },
+		{ "expect", required_argument, NULL, OPT_EXPECT },
+		{ "reject", required_argument, NULL, OPT_REJECT },
+		{ "expect-regex", required_argument, NULL, OPT_EXPECT_REGEX },
+		{ "reject-regex", required_argument, NULL, OPT_REJECT_REGEX },
+		{ "all-addresses", no_argument, NULL, OPT_ALL_ADDRESSES },
+		{ "balance", required_argument, NULL, OPT_BALANCE },
+		{ "tls", no_argument, NULL, OPT_TLS },
+		{ "tls-resume", no_argument, NULL, OPT_TLS_RESUME },
+		{ "ktls", no_argument, NULL, OPT_KTLS },
+		{ "http2", no_argument, NULL, OPT_HTTP2 },
+		{ "h2-connections", required_argument, NULL, OPT_H2_CONNECTIONS },
+		{ "h2-window", required_argument, NULL, OPT_H2_WINDOW },
+		{ "bind-addresses", required_argument, NULL, OPT_BIND_ADDRESSES },
+		{ "local-ports", required_argument, NULL, OPT_LOCAL_PORTS },
+		{ "fastopen", no_argument, NULL, OPT_FASTOPEN },
+		{ "linger0", no_argument, NULL, OPT_LINGER0 },
+		{ "lean", no_argument, NULL, OPT_LEAN },
+		{ "bandwidth", no_argument, NULL, OPT_BANDWIDTH },
+		{ "metrics-port", required_argument, NULL, OPT_METRICS_PORT },
+		{ "summary", required_argument, NULL, OPT_SUMMARY },
+		{ "group-by", required_argument, NULL, OPT_GROUP_BY },
+		{ "interval-log", required_argument, NULL, OPT_INTERVAL_LOG },
+		{ "rate-windows", required_argument, NULL, OPT_RATE_WINDOWS },
+		{ "warmup", required_argument, NULL, OPT_WARMUP },
+		{ "corpus", required_argument, NULL, OPT_CORPUS },
+		{ "template", no_argument, NULL, OPT_TEMPLATE },
+		{ "distribution", required_argument, NULL, OPT_DISTRIBUTION },
+		{ "record-hashes", required_argument, NULL, OPT_RECORD_HASHES },
+		{ "verify-hashes", required_argument, NULL, OPT_VERIFY_HASHES },
+		{ "agent", required_argument, NULL, OPT_AGENT },
+		{ "coordinator", required_argument, NULL, OPT_COORDINATOR },
 		{ NULL, 0, NULL, 0 }
 	};
 
 	int ch;
-	while ((ch = getopt_long(argc, argv, "hdlrp:q:PH:e:o:s:n:w:", opts, NULL)) != -1) {
+	while ((ch = getopt_long(argc, argv, "hdlrp:q:PH:e:o:s:n:w:S:", opts, NULL)) != -1) {
 		switch (ch) {
 		case 'h':
 			usage(argv[0]);
@@ -289,6 +697,139 @@ parse_arguments(int argc, char **argv)
 				exit(EXIT_FAILURE);
 			}
 			break;
+		case 'S':
+			{
+				char *end;
+				rng_seed = strtoull(optarg, &end, 0);
+				if (*end || !*optarg) {
+					fprintf(stderr, "Invalid seed '%s'\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				rng_seed_given = 1;
+			}
+			break;
+		case OPT_EXPECT:
+			add_match_rule(optarg, MATCH_EXPECT, 0);
+			break;
+		case OPT_REJECT:
+			add_match_rule(optarg, MATCH_REJECT, 0);
+			break;
+		case OPT_EXPECT_REGEX:
+			add_match_rule(optarg, MATCH_EXPECT, 1);
+			break;
+		case OPT_REJECT_REGEX:
+			add_match_rule(optarg, MATCH_REJECT, 1);
+			break;
+		case OPT_ALL_ADDRESSES:
+			all_addresses = 1;
+			break;
+		case OPT_BALANCE:
+			if (strcasecmp(optarg, "rr") == 0) {
+				balance_mode = BALANCE_ROUND_ROBIN;
+			} else if (strcasecmp(optarg, "least") == 0) {
+				balance_mode = BALANCE_LEAST_OUTSTANDING;
+			} else {
+				fprintf(stderr, "Unknown balance mode '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_TLS_RESUME:
+			tls_resume = 1;
+			use_tls = 1;
+			break;
+		case OPT_KTLS:
+			use_ktls = 1;
+			use_tls = 1;
+			break;
+		case OPT_TLS:
+			use_tls = 1;
+			break;
+		case OPT_HTTP2:
+			use_h2 = 1;
+			break;
+		case OPT_H2_CONNECTIONS:
+			{
+				char *end;
+				h2_connections = strtoul(optarg, &end, 10);
+				if (*end || h2_connections == 0) {
+					fprintf(stderr, "Invalid h2-connections '%s'\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+			}
+			break;
+		case OPT_H2_WINDOW:
+			{
+				char *end;
+				unsigned long w = strtoul(optarg, &end, 10);
+				if (*end || w < 65535 || w > 0x7fffffff) {
+					fprintf(stderr, "h2-window must be between 65535 and 2^31-1\n");
+					exit(EXIT_FAILURE);
+				}
+				h2_window = w;
+			}
+			break;
+		case OPT_BIND_ADDRESSES:
+			local_address_add(optarg);
+			break;
+		case OPT_LOCAL_PORTS:
+			local_ports_set(optarg);
+			break;
+		case OPT_FASTOPEN:
+#ifdef TCP_FASTOPEN_CONNECT
+			use_fastopen = 1;
+#else
+			fprintf(stderr, "TCP Fast Open is not supported on this system, ignoring --fastopen\n");
+#endif
+			break;
+		case OPT_LINGER0:
+			use_linger0 = 1;
+			break;
+		case OPT_LEAN:
+			lean = 1;
+			break;
+		case OPT_BANDWIDTH:
+			bandwidth_mode = 1;
+			break;
+		case OPT_METRICS_PORT:
+			parse_listen_address("metrics", optarg, &metrics_address, &metrics_port);
+			break;
+		case OPT_SUMMARY:
+			summary_filename = optarg;
+			break;
+		case OPT_GROUP_BY:
+			group_rule_add(optarg);
+			break;
+		case OPT_INTERVAL_LOG:
+			interval_log_filename = optarg;
+			break;
+		case OPT_RATE_WINDOWS:
+			parse_rate_windows(optarg);
+			break;
+		case OPT_WARMUP:
+			warmup_parse(optarg);
+			break;
+		case OPT_CORPUS:
+			corpus_filename = optarg;
+			break;
+		case OPT_TEMPLATE:
+			use_templates = 1;
+			break;
+		case OPT_DISTRIBUTION:
+			popularity_parse(optarg);
+			distribution = optarg;
+			break;
+		case OPT_RECORD_HASHES:
+			record_hashes = optarg;
+			break;
+		case OPT_VERIFY_HASHES:
+			verify_hashes = optarg;
+			break;
+		case OPT_AGENT:
+			parse_listen_address("agent", optarg, &agent_address, &agent_port);
+			break;
+		case OPT_COORDINATOR:
+			coordinator_agents = optarg;
+			break;
 		default:
 			usage(argv[0]);
 			exit(EXIT_FAILURE);
@@ -296,11 +837,60 @@ parse_arguments(int argc, char **argv)
 		}
 	}
 
-	if (argc - optind != 1) {
-		if (argc - optind < 1)
-			fprintf(stderr, "Missing host:port argument!\n");
-		else
-			fprintf(stderr, "Too many arguments!\n");
+	if (response_matcher)
+		matcher_compile(response_matcher);
+
+	if (use_h2 && use_tls) {
+		fprintf(stderr, "HTTP/2 is only supported over cleartext TCP (h2c)\n");
+		exit(EXIT_FAILURE);
+	}
+	if (corpus_filename && (use_h2 || coordinator_agents)) {
+		fprintf(stderr, "--corpus does not work with --http2 or --coordinator\n");
+		exit(EXIT_FAILURE);
+	}
+	if (corpus_filename && use_templates) {
+		fprintf(stderr, "--template does not work with --corpus\n");
+		exit(EXIT_FAILURE);
+	}
+	if (record_hashes && verify_hashes) {
+		fprintf(stderr, "Give either --record-hashes or --verify-hashes\n");
+		exit(EXIT_FAILURE);
+	}
+	if ((record_hashes || verify_hashes) && (bandwidth_mode || coordinator_agents)) {
+		fprintf(stderr, "--record-hashes and --verify-hashes do not work with "
+			"--bandwidth or --coordinator\n");
+		exit(EXIT_FAILURE);
+	}
+	if (distribution && coordinator_agents) {
+		/* Each agent would rank only its own share of the queries */
+		fprintf(stderr, "--distribution does not work with --coordinator\n");
+		exit(EXIT_FAILURE);
+	}
+	if (use_templates || distribution)
+		loop_mode = 1; /* A template or a distribution never runs out */
+	if (bandwidth_mode) {
+		if (!body_sink_supported()) {
+			fprintf(stderr, "--bandwidth needs splice(), which this system does not have\n");
+			exit(EXIT_FAILURE);
+		}
+		if (use_tls || use_h2 || response_matcher) {
+			fprintf(stderr, "--bandwidth never sees the response bodies, so it does not "
+				"work with TLS, HTTP/2 or response rules\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (use_h2 && h2_connections > num_parallell)
+		h2_connections = num_parallell;
+
+#ifndef HAVE_OPENSSL
+	if (use_tls) {
+		fprintf(stderr, "TLS support was not compiled in\n");
+		exit(EXIT_FAILURE);
+	}
+#endif
+
+	if (argc - optind < 1 && !agent_port) {
+		fprintf(stderr, "Missing host:port argument!\n");
 		usage(argv[0]);
 		exit(EXIT_FAILURE);
 	}
@@ -318,14 +908,48 @@ print_addresses(const struct addrinfo *ai)
 			fprintf(stderr, "numeric conv: %s\n", gai_strerror(error));
 			continue;
 		}
-		fprintf(stderr, "Address: %s port %s\n", host, service);
+		if (ai->ai_family == AF_UNIX)
+			fprintf(stderr, "Address: unix socket %s\n", host);
+		else
+			fprintf(stderr, "Address: %s port %s\n", host, service);
 	}
 }
 
 
+/* A unix:/path target, as a single addrinfo like getaddrinfo would return */
+static struct addrinfo *
+lookup_unix_socket(const char *path)
+{
+	struct sockaddr_un *sun;
+	size_t path_len = strlen(path);
+
+	if (path_len == 0 || path_len >= sizeof sun->sun_path) {
+		fprintf(stderr, "Invalid unix socket path '%s'\n", path);
+		return NULL;
+	}
+
+	struct addrinfo *res = calloc(1, sizeof *res + sizeof *sun);
+	if (!res) {
+		fprintf(stderr, "Failed to allocate memory for address: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	sun = (struct sockaddr_un *)(res + 1);
+	sun->sun_family = AF_UNIX;
+	memcpy(sun->sun_path, path, path_len + 1);
+	res->ai_family = AF_UNIX;
+	res->ai_socktype = SOCK_STREAM;
+	res->ai_protocol = 0;
+	res->ai_addr = (struct sockaddr *)sun;
+	res->ai_addrlen = offsetof(struct sockaddr_un, sun_path) + path_len + 1;
+	return res;
+}
+
 struct addrinfo *
 lookup_host(const char *address)
 {
+	if (strncmp(address, "unix:", 5) == 0)
+		return lookup_unix_socket(address + 5);
+
 	const char *colon = strchr(address, ':');
 	if (!colon) {
 		fprintf(stderr, "missing : in host/port name\n");
@@ -358,37 +982,83 @@ lookup_host(const char *address)
 	return res;
 }
 
-static size_t num_queries = 0;
-struct dynbuf queries;
-static char **query_list = 0;
+static void
+fd_move_failed(const char *what)
+{
+	fprintf(stderr, "Cannot move %s above the connection fds: %s%s\n", what, strerror(errno),
+		errno == EMFILE || errno == EINVAL ? " (raise ulimit -n)" : "");
+	exit(EXIT_FAILURE);
+}
 
-enum { MAX_FD_HEADROOM = 20 };
+int
+fd_above_connections(int fd)
+{
+	int high = fcntl(fd, F_DUPFD_CLOEXEC, connection_fds);
+	if (high == -1)
+		fd_move_failed("a file descriptor");
+	close(fd);
+	return high;
+}
+
+FILE *
+fopen_above_connections(const char *filename, const char *mode)
+{
+	FILE *f = fopen(filename, mode);
+	if (!f)
+		return NULL;
+	int fd = fcntl(fileno(f), F_DUPFD_CLOEXEC, connection_fds);
+	if (fd == -1)
+		fd_move_failed(filename);
+	fclose(f);
+	return fdopen(fd, mode);
+}
 
 static void
-run_benchmark(const char *hostname, const struct addrinfo *target)
+run_benchmark(void)
 {
-	query_function get_next_query = select_query_function();
-	connection_info = calloc(num_parallell + MAX_FD_HEADROOM, sizeof connection_info[0]);
+	connection_info = calloc(connection_fds, sizeof connection_info[0]);
 	init_wait(num_parallell);
-	struct expdecay query_stats;
-
-	expdecay_init(&query_stats);
+	if (metrics_port)
+		metrics_start(metrics_address, metrics_port);
+	if (bandwidth_mode)
+		body_sink_init();
+	if (agent_fd != -1)
+		agent_watch(&agent_fd, &stop_now);
+	unsigned int w;
+	for (w = 0; w < num_rate_windows; w++)
+		expdecay_init(&rate[w], rate_window[w]);
 	read_queries();
-	double next_report = now() + 1;
-	time_of_next_query = now(); /*  + waiter(query_interval); */
+	query_function get_next_query = select_query_function();
+	if (agent_fd != -1)
+		agent_ready(agent_fd);
+	run_start = now();
+	warmup_start(run_start);
+	if (interval_log_filename)
+		interval_log_open(interval_log_filename, run_start,
+				  query_interval ? 1.0 / query_interval : 0);
+	double next_report = run_start + 1;
+	time_of_next_query = run_start; /*  + waiter(query_interval); */
 	while (wait_num_pending() || !stop_now) {
 		double timestamp = now();
 		debug("Time until next query: %.3fms\n", (time_of_next_query - timestamp) * 1e3);
-		while (!stop_now && wait_num_pending() < num_parallell
-		       && timestamp >= time_of_next_query) {
-			const char *query = get_next_query();
+		while (!stop_now && can_send_query() && timestamp >= time_of_next_query) {
+			const struct query *query = get_next_query();
 			if (!query) {
 				num_parallell = 0;
 				fprintf(stderr, "Finished sending queries\n");
 				stop_now = 1;
 				goto next;
 			}
-			initiate_query(hostname, target, query);
+			if (query_interval > 0)
+				loop_stats_send(timestamp - time_of_next_query);
+			if (warming_up)
+				warmup_check(timestamp, queries_sent);
+			if (use_h2)
+				h2_submit(query);
+			else
+				initiate_query(target_pick(balance_mode), query);
+			if (num_groups && !warming_up)
+				groups[query->group].sent++;
 			time_of_next_query += waiter(query_interval);
 			debug("time_of_next_query = %.3f\n", time_of_next_query);
 			queries_sent++;
@@ -396,68 +1066,188 @@ run_benchmark(const char *hostname, const struct addrinfo *target)
 				stop_now = 1;
 			}
 		}
+		if (!stop_now && query_interval > 0 && timestamp >= time_of_next_query)
+			loop_stats_limited();
+		if (use_h2) {
+			h2_flush();
+			if (stop_now && !h2_streams_in_flight()) {
+				h2_close_idle();
+				continue;
+			}
+		}
 		double delta = next_report - timestamp;
-		if (wait_num_pending() < num_parallell && time_of_next_query < next_report) {
+		if (can_send_query() && time_of_next_query < next_report) {
 			debug("next report in %.3fms, but next query in %.3fms\n",
 			      delta * 1e3, 1e3 * (time_of_next_query - timestamp));
 			delta = time_of_next_query - timestamp;
 		}
- 		wait_for_action(&query_stats, stop_now ? 1000 : delta > 0 ? delta : 0);
+		loop_stats_idle();
+		wait_for_action(&rate[0], stop_now ? 1000 : delta > 0 ? delta : 0);
 	next:
 		if (stop_now) {
 			report_pending();
 		} else if (now() >= next_report) {
-			report_progress(&query_stats);
+			report_progress(&rate[0]);
 			next_report += 1;
 		}
 	}
+	run_end = now();
+	interval_log_close(run_end, queries_sent);
+	printf("\n");
+	fflush(stdout);
+}
+
+static void
+report_bandwidth(FILE *f)
+{
+	double elapsed = run_end - warmup_end();
+	double bytes = run_stats.response_bytes;
+	fprintf(f, "Received %.1f MB in %.2fs: %.1f MB/s, %.2f Gbit/s\n", bytes / 1e6, elapsed,
+		bytes / 1e6 / elapsed, 8 * bytes / 1e9 / elapsed);
 }
 
 static void
 report_progress(struct expdecay *query_stats)
 {
-	printf("q: %10lu q/s: %9.7g  \r", queries_sent, expdecay_value(query_stats));
+	double timestamp = now();
+	long time_wait = tcp_time_wait_count();
+	char windows[40], rates[80], client[120];
+	size_t wlen = 0, rlen = 0;
+	unsigned int w;
+
+	/* Decay the rates to now, in case nothing has completed for a while */
+	for (w = 0; w < num_rate_windows; w++) {
+		expdecay_update(&rate[w], 0, timestamp);
+		wlen += snprintf(windows + wlen, sizeof windows - wlen, "%s%gs", w ? "/" : "",
+				 rate_window[w]);
+		rlen += snprintf(rates + rlen, sizeof rates - rlen, "%s%.1f", w ? "/" : "",
+				 expdecay_value(&rate[w]));
+	}
+	loop_stats_interval(client, sizeof client, num_parallell);
+	if (time_wait >= 0)
+		printf("q: %10lu q/s %s: %s  TIME_WAIT: %6ld  %s  \r", queries_sent, windows,
+		       rates, time_wait, client);
+	else
+		printf("q: %10lu q/s %s: %s  %s  \r", queries_sent, windows, rates, client);
 	fflush(stdout);
+	if (agent_fd != -1)
+		agent_progress(agent_fd, queries_sent, stats_total(), expdecay_value(query_stats));
+	interval_log_write(timestamp, queries_sent);
+	warmup_interval(timestamp, queries_sent);
+	histogram_init(&run_stats.interval_latency);
 }
 
 static void
 report_pending(void)
 {
-	printf("STOPPING. Pending queries: %d                      \r", wait_num_pending());
+	printf("STOPPING. Pending queries: %d                      \r", queries_in_flight());
 	fflush(stdout);
 }
 
+static unsigned int
+queries_in_flight(void)
+{
+	return use_h2 ? h2_streams_in_flight() : wait_num_pending();
+}
 
-static void
-initiate_query(const char *hostname, const struct addrinfo *target, const char *query)
+static int
+can_send_query(void)
+{
+	return queries_in_flight() < num_parallell && (!use_h2 || h2_can_submit());
+}
+
+
+/* Count a failed connect and give up the socket, returns NULL for the caller */
+static struct conn_info *
+connect_failed(struct conn_info *conn)
 {
-	int fd = socket(target->ai_family, SOCK_STREAM, target->ai_protocol);
+	debug("connect on fd %d fails: %s\n", conn->fd, strerror(errno));
+	query_failed(conn, RESULT_CONNECT_ERROR);
+	close(conn->fd);
+	count_syscall(SC_CLOSE);
+	return NULL;
+}
+
+/* Create a nonblocking socket and start connecting it to target. The caller
+   fills in the rest of the conn_info and registers it with the poller. */
+struct conn_info *
+open_connection(struct target *target)
+{
+	const struct addrinfo *ai = target->ai;
+	int type = SOCK_STREAM;
+#ifdef SOCK_NONBLOCK
+	if (lean)
+		type |= SOCK_NONBLOCK | SOCK_CLOEXEC;
+#endif
+	int fd = socket(ai->ai_family, type, ai->ai_protocol);
+	count_syscall(SC_SOCKET);
 	if (fd == -1) {
-		fprintf(stderr, "initiate_query: socket() fails: %s\n", strerror(errno));
+		fprintf(stderr, "open_connection: socket() fails: %s\n", strerror(errno));
 		exit(EXIT_FAILURE);
 	}
-	rt_assert((unsigned int)fd < num_parallell + MAX_FD_HEADROOM);
+	rt_assert((unsigned int)fd < connection_fds);
 
 	/* Make sure socket is nonblocking, we don't want to wait! */
-	if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
-		fprintf(stderr, "initiate_query: fcntl fails: %s", strerror(errno));
-		exit(EXIT_FAILURE);
+	if (type == SOCK_STREAM) {
+		count_syscall(SC_FCNTL);
+		count_syscall(SC_FCNTL);
+		if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == -1) {
+			fprintf(stderr, "open_connection: fcntl fails: %s", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
 	}
 
 	struct conn_info *conn = &connection_info[fd];
 	conn->connect_time = now();
+	conn->connected_time = 0;
+	conn->first_result_time = 0;
+	conn->finished_result_time = 0;
 	conn->fd = fd;
 	conn->status = CONN_CONNECTING;
-	conn->query = query;
 	conn->target = target;
-	conn->hostname = hostname;
+	conn->query = NULL;
+	conn->warmup = warming_up;
+	conn->tls = NULL;
 	conn->pending_index = wait_num_pending();
-	conn->handler = handle_connected;
 	dynbuf_init(&conn->data);
+	conn->sunk_bytes = 0;
+	http_response_init(&conn->response);
+	if (hashing_responses)
+		response_hash_start(conn);
+
+	if (local_address_bind(fd, ai->ai_family) == -1) {
+		if (errno == EADDRINUSE || errno == EADDRNOTAVAIL)
+			return connect_failed(conn);
+		fprintf(stderr, "bind fails: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
 
-	int error = connect(fd, target->ai_addr, target->ai_addrlen);
+	if (use_linger0) {
+		/* Close with a RST, so we do not leave a socket in TIME_WAIT behind */
+		struct linger linger = { 1, 0 };
+		setsockopt(fd, SOL_SOCKET, SO_LINGER, &linger, sizeof linger);
+		count_syscall(SC_SETSOCKOPT);
+	}
+	conn->fastopen = 0;
+	conn->connect_deferred = 0;
+#ifdef TCP_FASTOPEN_CONNECT
+	if (use_fastopen && ai->ai_family != AF_UNIX) {
+		const int one = 1;
+		conn->fastopen = setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT,
+					    &one, sizeof one) == 0;
+		count_syscall(SC_SETSOCKOPT);
+	}
+#endif
+
+	int error = connect(fd, ai->ai_addr, ai->ai_addrlen);
+	count_syscall(SC_CONNECT);
 	if (error == -1) {
-		if (errno != EINPROGRESS) {
+		if (errno == EADDRNOTAVAIL || errno == EADDRINUSE || errno == EAGAIN
+		    || errno == ECONNREFUSED) {
+			/* Out of ports, or a unix socket with a full backlog. Count it and
+			   carry on, that is part of what is being measured. */
+			return connect_failed(conn);
+		} else if (errno != EINPROGRESS) {
 			fprintf(stderr, "connect fails immediately: %s\n", strerror(errno));
 			exit(EXIT_FAILURE);
 		} else {
@@ -465,8 +1255,48 @@ initiate_query(const char *hostname, const struct addrinfo *target, const char *
 		}
 	} else {
 		debug("connect on fd %d connected immediately!\n", fd);
+		/* With a Fast Open cookie for the server, connect() only records
+		   the address and the SYN waits for data */
+		conn->connect_deferred = conn->fastopen;
+	}
+	return conn;
+}
+
+static void
+initiate_query(struct target *target, const struct query *query)
+{
+	if (!warming_up)
+		target->sent++;
+	struct conn_info *conn = open_connection(target);
+	if (!conn) {
+		if (num_groups && !warming_up)
+			groups[query->group].errors++;
+		return;
 	}
-	wait_for_connected(conn);
+	conn->query = query;
+	if (query->tmpl)
+		conn->instance = template_instance();
+	conn->handler = handle_connected;
+	target->outstanding++;
+	if (lean && !use_tls)
+		wait_for_connected_then_read(conn); /* Saves changing the registration later */
+	else
+		wait_for_connected(conn);
+	if (conn->connect_deferred && !use_tls)
+		handle_connected(NULL, conn); /* Send the query in the SYN right away */
+}
+
+static void
+close_query(struct conn_info *conn)
+{
+	conn->status = CONN_UNUSED;
+	conn->target->outstanding--;
+	if (conn->tls)
+		tls_close(conn);
+	dynbuf_free(&conn->data);
+	unregister_wait(conn);
+	close(conn->fd);
+	count_syscall(SC_CLOSE);
 }
 
 
@@ -480,7 +1310,15 @@ do {						\
 query_function
 select_query_function(void)
 {
- 	if (loop_mode) {
+	if (distribution) {
+		/* The ranks follow the query list, shuffled first with -r */
+		if (random_mode)
+			randomize_query_list();
+		popularity_init(num_queries);
+		popularity_report(stderr);
+		return next_popular_query;
+	}
+	if (loop_mode) {
 		if (random_mode)
 			return next_random_query;
 		return next_loop_query;
@@ -495,42 +1333,58 @@ randomize_query_list(void)
 {
 	size_t n;
 	for (n = 0; n < num_queries - 1; n++) {
-		size_t idx = n + drand48() * (num_queries - n);
+		size_t idx = n + rng_below(&rng, num_queries - n);
 		SWAP(query_list[n], query_list[idx]);
 	}
 }
 
-static const char *
+static const struct query *
 next_random_query(void)
 {
-	unsigned int idx = drand48() * num_queries;
-	return query_list[idx];
+	size_t idx = rng_below(&rng, num_queries);
+	return &query_list[idx];
 }
 
-static const char *
+static const struct query *
+next_popular_query(void)
+{
+	return &query_list[popularity_sample(&rng)];
+}
+
+static const struct query *
 next_loop_query(void)
 {
 	static size_t idx;
 	if (idx >= num_queries)
 		idx = 0;
-	return query_list[idx++];
+	return &query_list[idx++];
 }
 
-static const char *
+static const struct query *
 next_query_noloop(void)
 {
 	static size_t idx;
 	if (idx >= num_queries)
 		return NULL;
-	return query_list[idx++];
+	return &query_list[idx++];
 }
 
+/* Inter-arrival times are generated in batches ahead of time, so the send loop
+   only has to pick the next one from the ring. */
+enum { ARRIVAL_RING_SIZE = 1024 };
+static double arrival_ring[ARRIVAL_RING_SIZE];
+static unsigned int arrival_pos = ARRIVAL_RING_SIZE;
+
 static double
 poisson_wait(double interval)
 {
-	/* Return the number of time units to wait for the next event in a Poisson process
-	   where the average waiting time is 1 */
-	return interval * -log(1.0 - drand48()); /* 1.0 - drand48() guaranteed > 0 */
+	/* Return the time to wait for the next event in a Poisson process where the
+	   average waiting time is interval */
+	if (arrival_pos == ARRIVAL_RING_SIZE) {
+		rng_fill_exponential(&rng, arrival_ring, ARRIVAL_RING_SIZE);
+		arrival_pos = 0;
+	}
+	return interval * arrival_ring[arrival_pos++];
 }
 
 static double
@@ -539,13 +1393,37 @@ regular_wait(double interval)
 	return interval;
 }
 
+static void
+read_corpus(void)
+{
+	size_t n;
+
+	/* Above the connections, which are indexed by fd */
+	num_queries = corpus_load(corpus_filename, connection_fds, &query_list);
+	fprintf(stderr, "Mapped %zu requests from '%s'\n", num_queries, corpus_filename);
+	for (n = 0; n < num_queries; n++) {
+		if (query_list[n].body && use_tls) {
+			fprintf(stderr, "Request bodies from a corpus do not work with --tls\n");
+			exit(EXIT_FAILURE);
+		}
+		query_list[n].group = group_classify(query_list[n].text);
+	}
+	if (num_groups)
+		fprintf(stderr, " - in %u groups\n", num_groups);
+}
+
 void
 read_queries(void)
 {
-	/* Read all the queries from stdin into an array. */
+	/* Read all the queries from stdin into an array. An agent has its share
+	   from the coordinator already. */
 	enum { BYTES_PER_READ = 16384 };
 
-	while (1) {
+	if (corpus_filename) {
+		read_corpus();
+		return;
+	}
+	while (agent_fd == -1) {
 		dynbuf_ensure_space(&queries, BYTES_PER_READ);
 		ssize_t l = read(0, queries.buffer + queries.pos, BYTES_PER_READ);
 		if (l == -1) {
@@ -556,6 +1434,8 @@ read_queries(void)
 			break;
 		queries.pos += l;
 	}
+	if (agent_fd != -1)
+		queries = job.queries;
 	dynbuf_ensure_space(&queries, 1);
 	queries.buffer[queries.pos++] = 0;
 	dynbuf_shrink(&queries);
@@ -581,11 +1461,32 @@ read_queries(void)
 	size_t n;
 	s = queries.buffer;
 	for (n = 0; n < num_queries; n++) {
-		query_list[n] = s;
+		query_list[n].text = s;
 		s = find_char_or_end(s, '\n', &queries.buffer[queries.pos]);
 		*s = 0;
 		s++;
+		query_list[n].group = group_classify(query_list[n].text);
+		query_list[n].body = NULL;
+		query_list[n].request = NULL;
+		query_list[n].tmpl = NULL;
+		if (use_templates && !coordinator_agents) {
+			/* The agents compile their own */
+			query_list[n].tmpl = template_compile(query_list[n].text, rng_seed);
+		} else if (use_post && query_list[n].text[0] == '@') {
+			if (use_tls || use_h2) {
+				fprintf(stderr, "POST bodies from files do not work with --tls or "
+					"--http2\n");
+				exit(EXIT_FAILURE);
+			}
+			agent_check_file("POST body", query_list[n].text + 1);
+			/* Above the connections, which are indexed by fd */
+			query_list[n].body = body_file_open(query_list[n].text + 1, connection_fds);
+		}
 	}
+	if (num_groups)
+		fprintf(stderr, " - in %u groups\n", num_groups);
+	if (body_files_open())
+		fprintf(stderr, " - with %u POST body files\n", body_files_open());
 }
 
 #ifndef MIN
@@ -593,13 +1494,39 @@ read_queries(void)
 #endif
 
 size_t
-generate_query(char *buf, size_t buf_len, const char *host, const char *query)
+generate_query(char *buf, size_t buf_len, const struct conn_info *conn)
 {
+	const struct query *q = conn->query;
+	const char *host = conn->target->hostname;
+	const char *query = q->text;
+	char expanded[TEMPLATE_MAX_LEN];
 	size_t would_write;
-	if (use_post) {
+	if (q->tmpl && use_post) {
+		template_expand(q->tmpl, conn->instance, expanded, sizeof expanded);
+		query = expanded;
+	}
+	if (q->request) {
+		/* The corpus has the request line, the other headers and the
+		   Content-Length already */
+		would_write = snprintf(buf, buf_len,
+				      "%.*sHost: %s\r\nConnection: close\r\n%s\r\n\r\n",
+				      (int)q->request_len, q->request, host, header);
+	} else if (q->body) {
+		/* Only the headers, send_body() sends the rest */
+		would_write = snprintf(buf, buf_len,
+				      "POST %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nContent-Length: %llu\r\n%s\r\n\r\n",
+				      query_prefix, host, (unsigned long long)q->body->size, header);
+	} else if (use_post) {
 		would_write = snprintf(buf, buf_len,
 				      "POST %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nContent-Length: %zu\r\n%s\r\n\r\n%s",
 				      query_prefix, host, strlen(query), header, query);
+	} else if (q->tmpl) {
+		/* Expand the template straight into the request line */
+		size_t pos = MIN(buf_len - 1, (size_t)snprintf(buf, buf_len, "GET %s", query_prefix));
+		pos += template_expand(q->tmpl, conn->instance, buf + pos, buf_len - pos);
+		would_write = pos + snprintf(buf + pos, buf_len - pos,
+					     " HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n%s\r\n\r\n",
+					     host, header);
 	} else {
 		would_write = snprintf(buf, buf_len,
 				      "GET %s%s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\n%s\r\n\r\n",
@@ -612,25 +1539,66 @@ generate_query(char *buf, size_t buf_len, const char *host, const char *query)
 static int
 handle_connected(struct expdecay *query_stats, struct conn_info *conn)
 {
-	(void)query_stats;
-	int fd = conn->fd;
-	debug("fd %d is now connected\n", fd);
+	debug("fd %d is now connected\n", conn->fd);
 	conn->status = CONN_CONNECTED;
 	conn->connected_time = now();
+	conn->handshake_time = 0;
 	conn->first_result_time = 0;
 	conn->finished_result_time = 0;
 
-	char buffer[20000];
-	size_t len = generate_query(buffer, sizeof buffer, conn->hostname, conn->query);
+	if (use_tls) {
+		conn->status = CONN_HANDSHAKING;
+		conn->handler = handle_handshake;
+		tls_start(conn);
+		return handle_handshake(query_stats, conn);
+	}
+	return send_query(conn);
+}
 
-	ssize_t written = write(fd, buffer, len);
+static int
+handle_handshake(struct expdecay *query_stats, struct conn_info *conn)
+{
+	(void)query_stats;
+	switch (tls_handshake(conn)) {
+	case TLS_WANT_READ:
+		wait_for_read(conn);
+		return 1;
+	case TLS_WANT_WRITE:
+		wait_for_write(conn);
+		return 1;
+	case TLS_ERROR:
+		query_failed(conn, RESULT_CONNECT_ERROR);
+		close_query(conn);
+		return -1;
+	case TLS_DONE:
+		break;
+	}
+	conn->handshake_time = now();
+	return send_query(conn);
+}
+
+static int
+send_query(struct conn_info *conn)
+{
+	int fd = conn->fd;
+	char buffer[20000];
+	size_t len = generate_query(buffer, sizeof buffer, conn);
+
+	ssize_t written;
+	if (conn->tls)
+		written = tls_write(conn, buffer, len);
+#ifdef MSG_NOSIGNAL
+	else if (lean)
+		written = send(fd, buffer, len, MSG_NOSIGNAL);
+#endif
+	else
+		written = write(fd, buffer, len);
+	count_syscall(SC_WRITE);
 	int saved_errno = errno;
 	if (written == -1) {
 		fprintf(stderr, "Write to fd %d fails: %s\n", fd, strerror(errno));
-		conn->status = CONN_UNUSED;
-		dynbuf_free(&conn->data);
-		unregister_wait(conn);
-		close(fd);
+		query_failed(conn, RESULT_WRITE_ERROR);
+		close_query(conn);
 		errno = saved_errno;
 		return -1;
 	}
@@ -639,8 +1607,8 @@ handle_connected(struct expdecay *query_stats, struct conn_info *conn)
 		   than the socket buffer */
 		fprintf(stderr, "Short write to fd %d: %llu/%llu, aborting query\n", fd,
 			(unsigned long long)written, (unsigned long long)len);
-		unregister_wait(conn);
-		close(fd);
+		query_failed(conn, RESULT_WRITE_ERROR);
+		close_query(conn);
 		errno = EWOULDBLOCK;
 		return -1;
 	}
@@ -648,12 +1616,82 @@ handle_connected(struct expdecay *query_stats, struct conn_info *conn)
 	debug("Wrote to fd %d %d bytes: '%s'\n", fd, (int)written,
 		buffer);
 
+	if (conn->query->body) {
+		conn->body_offset = 0;
+		return send_body(conn);
+	}
 	conn->handler = handle_readable;
 	wait_for_read(conn);
 	debug("pending_list[%d].events = POLLIN\n", conn->pending_index);
 	return 0;
 }
 
+/* Send what is left of a body file, waiting for the socket to drain when
+   it has to */
+static int
+send_body(struct conn_info *conn)
+{
+	const struct body_file *body = conn->query->body;
+
+	while (conn->body_offset < body->size) {
+		ssize_t written = body_file_send(conn->fd, body, conn->body_offset);
+		if (written == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			conn->handler = handle_body_writable;
+			wait_for_write(conn);
+			return 1;
+		}
+		if (written <= 0) {
+			fprintf(stderr, "Sending '%s' to fd %d fails: %s\n", body->path, conn->fd,
+				written ? strerror(errno) : "the file got shorter");
+			query_failed(conn, RESULT_WRITE_ERROR);
+			close_query(conn);
+			return -1;
+		}
+		conn->body_offset += written;
+	}
+	debug("Sent %llu body bytes to fd %d\n", (unsigned long long)body->size, conn->fd);
+
+	conn->handler = handle_readable;
+	wait_for_read(conn);
+	return 0;
+}
+
+static int
+handle_body_writable(struct expdecay *query_stats, struct conn_info *conn)
+{
+	(void)query_stats;
+	return send_body(conn);
+}
+
+/* Is the whole body there, according to Content-Length or the last chunk? */
+static int
+response_complete(struct conn_info *conn)
+{
+	struct http_response *r = &conn->response;
+	if (!http_scan_headers(r, conn->data.buffer, conn->data.pos))
+		return 0;
+	if (r->chunked)
+		return r->body_complete;
+	if (r->content_length < 0)
+		return 0;
+	return conn->data.pos + conn->sunk_bytes - r->header_len >= (size_t)r->content_length;
+}
+
+/* Splice the body away until EOF or EWOULDBLOCK, returning like read() */
+static int
+sink_body(struct conn_info *conn)
+{
+	ssize_t len;
+	do {
+		if (lean && response_complete(conn))
+			return 0;
+		len = body_sink(conn->fd, SIZE_MAX);
+		if (len > 0)
+			conn->sunk_bytes += len;
+	} while (len > 0);
+	return len;
+}
+
 static int
 handle_readable(struct expdecay *query_stats, struct conn_info *conn)
 {
@@ -669,39 +1707,50 @@ handle_readable(struct expdecay *query_stats, struct conn_info *conn)
 		INITIAL_DYNBUF_RESERVATION = 8128,
 	};
 	dynbuf_ensure_space(&conn->data, INITIAL_DYNBUF_RESERVATION);
-	do {
+	if (bandwidth_mode && conn->response.header_len)
+		len = sink_body(conn);
+	else do {
 		dynbuf_ensure_space(&conn->data, BYTES_PER_NETWORK_READ + 1);
-		len = read(fd, conn->data.buffer + conn->data.pos, BYTES_PER_NETWORK_READ);
+		char *dst = conn->data.buffer + conn->data.pos;
+		if (conn->tls)
+			len = tls_read(conn, dst, BYTES_PER_NETWORK_READ);
+		else
+			len = read(fd, dst, BYTES_PER_NETWORK_READ);
+		count_syscall(SC_READ);
 		if (len > 0) {
 			conn->data.pos += len;
 			debug("got %d bytes from fd %d\n", len, fd);
+			struct http_response *r = &conn->response;
+			if (!bandwidth_mode && http_scan_headers(r, conn->data.buffer, conn->data.pos)
+			    && r->chunked)
+				conn->data.pos = http_dechunk(r, conn->data.buffer, conn->data.pos);
+			if (hashing_responses && r->header_len)
+				response_hash_update(conn, r->header_len,
+						     http_body_end(r, conn->data.pos));
+			if (lean && response_complete(conn)) {
+				/* No need for another read to see the EOF */
+				len = 0;
+				break;
+			}
+			if (bandwidth_mode && http_scan_headers(&conn->response, conn->data.buffer,
+								conn->data.pos)) {
+				/* We have the headers, the rest goes straight to /dev/null */
+				len = sink_body(conn);
+				break;
+			}
 		}
 	} while (len > 0);
 
+	if (!conn->response.header_len)
+		http_scan_headers(&conn->response, conn->data.buffer, conn->data.pos);
+
 	if (len == 0) {
-		double timestamp = now();
-		expdecay_update(query_stats, 1, timestamp);
-		conn->finished_result_time = timestamp;
+		conn->finished_result_time = now();
 		conn->data.buffer[conn->data.pos] = 0; /* Zero terminate the result for str fns */
 		debug("EOF on fd %d. Total length = %d\n", fd, (int)conn->data.pos);
 		spam("Received data:\n%s\n", conn->data.buffer);
 		int http_result_code = parse_http_result_code(conn->data.buffer, conn->data.pos);
-		/* @@@ Parse the result more here, e.g. check that various regexes match
-		   or similar? */
-		fprintf(querylog_file,
-			"%.6f RES=%d LEN=%d TC=%.1fms T1=%.1fms TF=%.1fms Q=\"%s\"\n",
-			timestamp, http_result_code, (int)conn->data.pos,
-			1e3 * (conn->connected_time - conn->connect_time),
-			1e3 * (conn->first_result_time - conn->connect_time),
-			1e3 * (conn->finished_result_time - conn->connect_time),
-			conn->query);
-
-		/* Log the complete query and result if there was an error */
-		if (http_result_code < 200 || http_result_code > 299) {
-			fprintf(error_file, "%.6f Q=\"%s\"\nERROR RESULT:\n%s\n",
-				timestamp, conn->query, conn->data.buffer);
-		}
-
+		query_done(query_stats, conn, http_result_code);
 	} else if (len == -1) {
 		if (errno == EWOULDBLOCK) {
 			debug("must wait for more data from fd %d\n", fd);
@@ -712,14 +1761,161 @@ handle_readable(struct expdecay *query_stats, struct conn_info *conn)
 			return 1;
 		}
 		fprintf(stderr, "Read error on fd %d: %s\n", fd, strerror(errno));
+		query_failed(conn, RESULT_READ_ERROR);
 	}
 
-	dynbuf_free(&conn->data);
-	unregister_wait(conn);
-	close(fd);
+	close_query(conn);
 	return len;
 }
 
+/* Did the server take the data we sent in the SYN? */
+static int
+fastopen_used(int fd)
+{
+#ifdef TCPI_OPT_SYN_DATA
+	struct tcp_info info;
+	socklen_t len = sizeof info;
+	count_syscall(SC_GETSOCKOPT);
+	if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0)
+		return (info.tcpi_options & TCPI_OPT_SYN_DATA) != 0;
+#else
+	(void)fd;
+#endif
+	return 0;
+}
+
+/* Account for a query that ended without a response */
+void
+query_failed(struct conn_info *conn, enum result_class result)
+{
+	if (conn->warmup) {
+		run_stats.warmup++;
+		return;
+	}
+	run_stats.results[result]++;
+	conn->target->errors++;
+	stats_record_latency(conn, 0, result);
+	if (num_groups && conn->query)
+		groups[conn->query->group].errors++;
+}
+
+/* Account for a finished query: classify the result, update the statistics and
+   write the query log. conn->data holds the response, from header_len on the body. */
+static void
+count_result(struct conn_info *conn, int http_result_code, enum result_class result)
+{
+	run_stats.results[result]++;
+	if (http_result_code >= 100 && http_result_code < 600)
+		run_stats.status_codes[http_result_code]++;
+	conn->target->completed++;
+	if (result != RESULT_OK)
+		conn->target->errors++;
+	histogram_record(&conn->target->latency,
+			 conn->finished_result_time - conn->connect_time);
+	if (num_groups) {
+		struct group *g = &groups[conn->query->group];
+		g->completed++;
+		if (result != RESULT_OK)
+			g->errors++;
+		histogram_record(&g->latency, conn->finished_result_time - conn->connect_time);
+	}
+	stats_record_latency(conn, http_result_code, result);
+}
+
+/* The query as sent, a template is expanded again for the log */
+static const char *
+query_text(const struct conn_info *conn, char *buf, size_t len)
+{
+	if (!conn->query->tmpl)
+		return conn->query->text;
+	template_expand(conn->query->tmpl, conn->instance, buf, len);
+	return buf;
+}
+
+void
+query_done(struct expdecay *query_stats, struct conn_info *conn, int http_result_code)
+{
+	double timestamp = conn->finished_result_time;
+	char text[TEMPLATE_MAX_LEN];
+	unsigned int w;
+	expdecay_update(query_stats, 1, timestamp);
+	for (w = 1; w < num_rate_windows; w++) /* query_stats is rate[0] */
+		expdecay_update(&rate[w], 1, timestamp);
+
+	const char *query = query_text(conn, text, sizeof text);
+	enum result_class result = RESULT_OK;
+	const char *failed_rule = NULL;
+	if (http_result_code == -1) {
+		result = RESULT_BAD_RESPONSE;
+	} else if (http_result_code < 200 || http_result_code > 299) {
+		result = RESULT_HTTP_ERROR;
+	} else if (response_matcher) {
+		/* The decoded body, without any chunk framing left undecoded */
+		size_t body = conn->response.header_len;
+		size_t end = http_body_end(&conn->response, conn->data.pos);
+		failed_rule = matcher_check(response_matcher, conn->data.buffer + body, end - body);
+		if (failed_rule)
+			result = RESULT_INVALID;
+	}
+	uint64_t hash = 0, expected = 0;
+	enum hash_result hash_result = HASH_UNKNOWN;
+	if (hashing_responses)
+		hash_result = response_hash_done(conn, query, http_result_code, &hash, &expected);
+	size_t response_len = conn->data.pos + conn->sunk_bytes + conn->response.framing_bytes;
+	if (conn->warmup) {
+		/* Only the query log and the time series see the warm-up */
+		run_stats.warmup++;
+		histogram_record(&run_stats.interval_latency,
+				 conn->finished_result_time - conn->connect_time);
+	} else {
+		count_result(conn, http_result_code, result);
+		run_stats.response_bytes += response_len;
+	}
+	fprintf(querylog_file, "%.6f RES=%d LEN=%zu TC=%.1fms ",
+		timestamp, http_result_code, response_len,
+		1e3 * (conn->connected_time - conn->connect_time));
+	if (conn->fastopen) {
+		int used = fastopen_used(conn->fd);
+		run_stats.fastopen_attempted++;
+		run_stats.fastopen_used += used;
+		fprintf(querylog_file, "TFO=%d ", used);
+	}
+	if (conn->tls) {
+		fprintf(querylog_file, "TH=%.1fms TLSR=%d ",
+			1e3 * (conn->handshake_time - conn->connected_time),
+			conn->tls_resumed);
+	}
+	fprintf(querylog_file, "T1=%.1fms TF=%.1fms Q=\"%s\"",
+		1e3 * (conn->first_result_time - conn->connect_time),
+		1e3 * (conn->finished_result_time - conn->connect_time), query);
+	if (conn->response.server_timing_len) {
+		fprintf(querylog_file, " ST=\"%.*s\"", (int)conn->response.server_timing_len,
+			conn->data.buffer + conn->response.server_timing_off);
+	}
+	if (failed_rule)
+		fprintf(querylog_file, " CHECK=FAIL");
+	if (hashing_responses)
+		fprintf(querylog_file, " HASH=%016llx", (unsigned long long)hash);
+	if (hash_result == HASH_MISMATCH)
+		fprintf(querylog_file, " HASH_CHECK=FAIL");
+	if (conn->warmup)
+		fprintf(querylog_file, " WARMUP=1");
+	fputc('\n', querylog_file);
+
+	/* Log the complete query and result if there was an error */
+	if (failed_rule) {
+		fprintf(error_file, "%.6f Q=\"%s\"\nVALIDATION FAILED: %s\n%s\n",
+			timestamp, query, failed_rule, conn->data.buffer);
+	} else if (result != RESULT_OK) {
+		fprintf(error_file, "%.6f Q=\"%s\"\nERROR RESULT:\n%s\n",
+			timestamp, query, conn->data.buffer);
+	} else if (hash_result == HASH_MISMATCH) {
+		fprintf(error_file, "%.6f Q=\"%s\"\nRESPONSE DIFFERS: hash %016llx, recorded %016llx\n%s\n",
+			timestamp, query, (unsigned long long)hash, (unsigned long long)expected,
+			conn->data.buffer);
+	}
+}
+
 static int
 parse_http_result_code(const char *buf, size_t len)
 {
@@ -780,7 +1976,7 @@ signal_handler(int sig)
 static void
 usage(const char *name)
 {
-	fprintf(stderr, "Usage: %s [OPTIONS] <host>:<port>\n\n"
+	fprintf(stderr, "Usage: %s [OPTIONS] <host>:<port> [<host>:<port> ...]\n\n"
 		" -d --debugging : Increase debug level (-d -d for spam)\n"
 		" -l --loop-mode : Run the same queries multple times\n"
 		" -e --errors <file> : Log all failed queries to <file> [cxbench.errors]\n"
@@ -790,7 +1986,71 @@ usage(const char *name)
 		" -s --qps <rate> : Submit queries with <rate> qps. 0 means infinite\n"
 		" -n --num-queries <n>: Stop after <n> queries\n"
 		" -q --query-prefix <prefix> : Prepend <prefix> to all queries\n"
-		" -w --wait-mode <mode> : Wait mode poisson or regular [poisson]\n\n"
+		" -P --use-post : POST the queries to <prefix> instead. A query @<path> sends the\n"
+		"      file <path> as the body\n"
+		" -w --wait-mode <mode> : Wait mode poisson or regular [poisson]\n"
+		" -S --seed <n> : Seed the random generator with <n> to reproduce a run\n"
+		"    --expect <string> : Responses must contain <string>\n"
+		"    --reject <string> : Responses must not contain <string>\n"
+		"    --expect-regex <regex> : Responses must match <regex>\n"
+		"    --reject-regex <regex> : Responses must not match <regex>\n"
+		"      (Failing responses are counted as invalid and logged to the error file)\n"
+		"    --all-addresses : Use every address a host resolves to, not just the first\n"
+		"    --balance <mode> : Spread queries over the targets with rr or least\n"
+		"      (least outstanding queries) [rr]\n"
+		"    --tls : Connect with TLS (certificates are not verified)\n"
+		"    --tls-resume : Resume TLS sessions with session tickets/IDs (implies --tls)\n"
+		"    --ktls : Let OpenSSL use kernel TLS offload when possible (implies --tls)\n"
+		"    --http2 : Use HTTP/2 with prior knowledge (h2c). -p is then the number of\n"
+		"      concurrent streams, spread over --h2-connections connections\n"
+		"    --h2-connections <n> : Number of HTTP/2 connections [1]\n"
+		"    --h2-window <bytes> : HTTP/2 receive flow control window [1048576]\n"
+		"    --bind-addresses <a,b,...> : Spread the connections over these local addresses\n"
+		"    --local-ports <low>-<high> : Pick local ports from this range ourselves, in order\n"
+		"    --fastopen : Use TCP Fast Open, sending the request in the SYN when the server\n"
+		"      has given us a cookie\n"
+		"    --linger0 : Close connections with a RST instead of leaving them in TIME_WAIT\n"
+		"    --lean : Use fewer syscalls per query: nonblocking sockets from socket(), one\n"
+		"      poller registration, and no read for the EOF once the body is complete\n"
+		"      by Content-Length or the last chunk\n"
+		"    --bandwidth : Read only the response headers, splice the bodies to /dev/null\n"
+		"      and report the throughput\n"
+		"    --metrics-port [<address>:]<port> : Serve Prometheus metrics on\n"
+		"      http://<address>:<port>/metrics, <address> is 127.0.0.1 unless given\n"
+		"    --summary <file> : Write a JSON summary of the run to <file> at the end\n"
+		"    --interval-log <file> : Write a line per second to <file> with the queries,\n"
+		"      errors, throughput, rates and latency percentiles of that second\n"
+		"    --warmup <n>s|<n>|auto[:<pct>] : Leave the first <n> seconds or <n> queries\n"
+		"      out of the statistics, or wait until the rate and the median latency\n"
+		"      stay within <pct>%% [10] for 5 seconds\n"
+		"    --corpus <file> : Send the requests compiled into <file> by cxbench-compile,\n"
+		"      each with its own method, headers and body, instead of reading STDIN\n"
+		"    --template : The queries are templates, expanded afresh for each request\n"
+		"      and looped over (-l). {dict:<file>} is a random line of <file>,\n"
+		"      {rand:<low>..<high>} a random number, {seq} the request number, {{ a {\n"
+		"    --distribution zipf:<s>|hotset:<fraction>:<probability> : Pick the queries\n"
+		"      with a skewed popularity instead of in order, implies -l. The query at\n"
+		"      rank k (in STDIN order, or shuffled with -r) is picked with probability\n"
+		"      proportional to 1/k^s, or the first <fraction> of the queries get\n"
+		"      <probability> of the requests\n"
+		"    --record-hashes <file> : Write the status and a hash of the body of each\n"
+		"      query's response to <file>, to check later runs against\n"
+		"    --verify-hashes <file> : Count the responses whose status or body differ\n"
+		"      from the ones recorded in <file> with --record-hashes\n"
+		"    --rate-windows <s,...> : Show the completion rate smoothed over these\n"
+		"      windows in seconds on the progress line, the first one is also used for\n"
+		"      the metrics [1,10,60]\n"
+		"    --group-by <rule> : Keep statistics per query group. The rule is prefix:<n> for\n"
+		"      the path up to the <n>th '/', or regex:<regex> for the first capture (or the\n"
+		"      whole match). Can be repeated, the first rule that matches is used\n"
+		"    --agent [<address>:]<port> : Wait for a coordinator on <port> and run the\n"
+		"      jobs it sends. <address> is 127.0.0.1 unless given. The files a job names\n"
+		"      must be in the working directory of the agent\n"
+		"    --coordinator <host:port,...> : Run on these agents instead. The queries and\n"
+		"      the rate (-s, -n) are split between them, -p applies to each agent. The\n"
+		"      agents write their logs to <file>.<n>. The coordinator and the agents need\n"
+		"      the same secret in CXBENCH_TOKEN\n\n"
+		"A target can also be unix:<path> to connect to a unix domain socket.\n"
 		"A list of queries must be given on STDIN.\n\n", name);
 }
 
@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <stdarg.h>
 
 #include "dynbuf.h"
 
@@ -66,6 +67,25 @@ dynbuf_shrink(struct dynbuf *d)
 	}
 };
 
+void
+dynbuf_printf(struct dynbuf *d, const char *fmt, ...)
+{
+	va_list ap;
+	char dummy;
+
+	va_start(ap, fmt);
+	int len = vsnprintf(&dummy, 1, fmt, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+
+	dynbuf_ensure_space(d, len + 1);
+	va_start(ap, fmt);
+	vsnprintf(d->buffer + d->pos, len + 1, fmt, ap);
+	va_end(ap);
+	d->pos += len;
+}
+
 
 /* Local Variables: */
 /* c-basic-offset:8 */
@@ -33,6 +33,7 @@ void dynbuf_init(struct dynbuf *);
 void dynbuf_free(struct dynbuf *);
 void dynbuf_ensure_space(struct dynbuf *, size_t n); /* Make room for n more bytes */
 void dynbuf_shrink(struct dynbuf *); /* Shrink the allocation to exactly fit what is in the dynbuf */
+void dynbuf_printf(struct dynbuf *, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
 
 #endif /* !DYNBUF_H */
 
@@ -22,12 +22,12 @@
 #include "debug.h"
 
 void
-expdecay_init(struct expdecay *ed)
+expdecay_init(struct expdecay *ed, double window)
 {
 	ed->last_update = now();
 	ed->value = 0;
 	ed->base_value = 0;
-	ed->decay_factor = 0.97; /* @@@ should be configurable */
+	ed->decay_factor = exp(-1 / window);
 }
 
 double
@@ -27,7 +27,8 @@ struct expdecay {
 
 double expdecay_value(const struct expdecay *);
 void expdecay_update(struct expdecay *, double value, double timestamp);
-void expdecay_init(struct expdecay *);
+/* Old events count 1/e as much after window seconds */
+void expdecay_init(struct expdecay *, double window);
 
 #endif /* !EXPDECAY_H */
 
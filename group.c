@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <regex.h>
+
+#include "group.h"
+
+/* More groups than this is a rule that matches ids or timestamps, put the
+   rest in the catch-all group instead of using a histogram for each */
+enum { MAX_GROUPS = 1000 };
+
+struct group_rule {
+	unsigned int prefix_depth; /* 0 for a regex rule */
+	regex_t re;
+};
+
+struct group *groups;
+unsigned int num_groups;
+
+static struct group_rule *rules;
+static unsigned int num_rules;
+
+/* Group names to group ids, open addressing. Only used while classifying. */
+static unsigned int *name_table;
+static unsigned int name_table_size;
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+void
+group_rule_add(const char *spec)
+{
+	rules = xrealloc(rules, (num_rules + 1) * sizeof rules[0]);
+	struct group_rule *rule = &rules[num_rules];
+	memset(rule, 0, sizeof *rule);
+
+	if (strncmp(spec, "prefix:", 7) == 0) {
+		char *end;
+		rule->prefix_depth = strtoul(spec + 7, &end, 10);
+		if (*end || rule->prefix_depth == 0) {
+			fprintf(stderr, "Invalid prefix depth in '%s'\n", spec);
+			exit(EXIT_FAILURE);
+		}
+	} else if (strncmp(spec, "regex:", 6) == 0) {
+		int error = regcomp(&rule->re, spec + 6, REG_EXTENDED);
+		if (error) {
+			char msg[200];
+			regerror(error, &rule->re, msg, sizeof msg);
+			fprintf(stderr, "Invalid regex '%s': %s\n", spec + 6, msg);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		fprintf(stderr, "Unknown group rule '%s', use prefix:<n> or regex:<regex>\n", spec);
+		exit(EXIT_FAILURE);
+	}
+	num_rules++;
+}
+
+static uint32_t
+hash_name(const char *name, size_t len)
+{
+	uint32_t h = 2166136261u; /* FNV-1a */
+	size_t n;
+
+	for (n = 0; n < len; n++)
+		h = (h ^ (unsigned char)name[n]) * 16777619u;
+	return h;
+}
+
+static unsigned int
+new_group(const char *name, size_t len)
+{
+	groups = xrealloc(groups, (num_groups + 1) * sizeof groups[0]);
+	struct group *g = &groups[num_groups];
+	memset(g, 0, sizeof *g);
+	g->name = xrealloc(NULL, len + 1);
+	memcpy(g->name, name, len);
+	g->name[len] = 0;
+	histogram_init(&g->latency);
+	return num_groups++;
+}
+
+/* The id of the group called name, creating it if there is room */
+static unsigned int
+find_group(const char *name, size_t len)
+{
+	unsigned int n;
+
+	if (!name_table) {
+		name_table_size = 2 * MAX_GROUPS;
+		name_table = xrealloc(NULL, name_table_size * sizeof name_table[0]);
+		for (n = 0; n < name_table_size; n++)
+			name_table[n] = UINT32_MAX;
+		/* Group 0 takes what no rule matches */
+		name_table[hash_name("other", 5) % name_table_size] = new_group("other", 5);
+	}
+	for (n = hash_name(name, len) % name_table_size; ; n = (n + 1) % name_table_size) {
+		unsigned int id = name_table[n];
+		if (id == UINT32_MAX)
+			break;
+		if (strncmp(groups[id].name, name, len) == 0 && !groups[id].name[len])
+			return id;
+	}
+	if (num_groups == MAX_GROUPS)
+		return 0;
+	name_table[n] = new_group(name, len);
+	if (num_groups == MAX_GROUPS)
+		fprintf(stderr, "More than %d query groups, the rest go in 'other'\n", MAX_GROUPS - 1);
+	return name_table[n];
+}
+
+/* The query up to the depth'th '/' after the start, or the query string */
+static size_t
+prefix_length(const char *query, unsigned int depth)
+{
+	size_t len = strcspn(query, "?#");
+	size_t n;
+
+	for (n = 1; n < len; n++) {
+		if (query[n] == '/' && !--depth)
+			return n;
+	}
+	return len;
+}
+
+unsigned int
+group_classify(const char *query)
+{
+	unsigned int r, id = 0;
+
+	if (!num_rules)
+		return 0;
+	for (r = 0; r < num_rules; r++) {
+		const struct group_rule *rule = &rules[r];
+		if (rule->prefix_depth) {
+			size_t len = prefix_length(query, rule->prefix_depth);
+			if (len) {
+				id = find_group(query, len);
+				break;
+			}
+			continue;
+		}
+		/* The first capture names the group, or the whole match if there is none */
+		regmatch_t match[2];
+		if (regexec(&rule->re, query, 2, match, 0) != 0)
+			continue;
+		const regmatch_t *m = rule->re.re_nsub && match[1].rm_so != -1 ? &match[1] : &match[0];
+		id = find_group(query + m->rm_so, m->rm_eo - m->rm_so);
+		break;
+	}
+	if (!num_groups)
+		find_group("other", 5);
+	groups[id].queries++;
+	return id;
+}
+
+struct group *
+group_named(const char *name)
+{
+	return &groups[find_group(name, strlen(name))];
+}
+
+void
+group_report(FILE *f)
+{
+	unsigned int n;
+
+	fprintf(f, "%-28s %10s %10s %10s %8s %9s %9s %9s %9s\n", "Group", "Queries", "Sent",
+		"Completed", "Errors", "Mean", "p50", "p99", "Max");
+	for (n = 0; n < num_groups; n++) {
+		const struct group *g = &groups[n];
+		const struct histogram *h = &g->latency;
+		if (!g->queries)
+			continue;
+		fprintf(f, "%-28s %10lu %10lu %10lu %8lu %7.1fms %7.1fms %7.1fms %7.1fms\n",
+			g->name, g->queries, g->sent, g->completed, g->errors,
+			1e3 * histogram_mean(h), 1e3 * histogram_percentile(h, 50),
+			1e3 * histogram_percentile(h, 99), 1e3 * h->max);
+	}
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef GROUP_H
+#define GROUP_H
+
+/* Per endpoint statistics. With --group-by rules each query is put in a
+ * group once, when the queries are read, so accounting for a query is just
+ * an array index. */
+
+#include <stdio.h>
+
+#include "histogram.h"
+
+struct group {
+	char *name;
+	unsigned long queries; /* In the input */
+	unsigned long sent;
+	unsigned long completed;
+	unsigned long errors;
+	struct histogram latency;
+};
+
+extern struct group *groups;
+extern unsigned int num_groups; /* 0 unless there are --group-by rules */
+
+void group_rule_add(const char *spec); /* prefix:<n> or regex:<regex> */
+unsigned int group_classify(const char *query); /* Once for each query read */
+struct group *group_named(const char *name); /* Created if it is new */
+void group_report(FILE *);
+
+#endif /* !GROUP_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,996 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "h2.h"
+#include "debug.h"
+#include "dynbuf.h"
+#include "timeutil.h"
+#include "connection-info.h"
+#include "wait-interface.h"
+#include "target.h"
+#include "stats.h"
+#include "syscall-stats.h"
+#include "warmup.h"
+#include "template.h"
+#include "response-hash.h"
+
+enum {
+	FRAME_HEADER_LEN = 9,
+
+	FRAME_DATA = 0,
+	FRAME_HEADERS = 1,
+	FRAME_RST_STREAM = 3,
+	FRAME_SETTINGS = 4,
+	FRAME_PING = 6,
+	FRAME_GOAWAY = 7,
+	FRAME_WINDOW_UPDATE = 8,
+	FRAME_CONTINUATION = 9,
+
+	FLAG_END_STREAM = 0x1,
+	FLAG_ACK = 0x1,
+	FLAG_END_HEADERS = 0x4,
+	FLAG_PADDED = 0x8,
+	FLAG_PRIORITY = 0x20,
+
+	SETTINGS_HEADER_TABLE_SIZE = 0x1,
+	SETTINGS_ENABLE_PUSH = 0x2,
+	SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+	SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+	SETTINGS_MAX_FRAME_SIZE = 0x5,
+
+	DEFAULT_WINDOW = 65535,
+	DEFAULT_MAX_FRAME = 16384,
+	MAX_STREAM_ID = 0x7fffffff,
+	BYTES_PER_NETWORK_READ = 16384,
+	MAX_NO_STREAM_CONNS = 3, /* Connections in a row allowing no streams */
+};
+
+static const char preface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+struct h2_stream {
+	struct conn_info info; /* Times, query and response body, like a HTTP/1 query */
+	uint32_t id; /* 0 if the slot is free */
+	uint32_t recv_unacked; /* DATA received but not yet given back in a WINDOW_UPDATE */
+	int64_t send_window; /* What the server lets us send, negative after a SETTINGS shrink */
+	struct dynbuf body; /* The POST body */
+	size_t body_sent;
+	int body_pending; /* Some of the body, or its END_STREAM, has not gone out */
+	int http_status;
+};
+
+struct h2_conn {
+	struct conn_info *conn; /* The socket, NULL when not connected */
+	struct target *target;
+	struct dynbuf out;
+	size_t out_sent;
+	struct dynbuf in;
+	struct dynbuf header_block; /* HEADERS + CONTINUATION being collected */
+	uint32_t header_stream;
+	int header_end_stream;
+	struct h2_stream *streams; /* Stream id n lives in slot (n / 2) % max_streams */
+	unsigned int num_active;
+	uint32_t next_stream_id;
+	uint32_t peer_max_streams;
+	uint32_t recv_unacked;
+	int64_t send_window; /* The server's connection window for our DATA */
+	uint32_t peer_initial_window; /* For new streams, SETTINGS_INITIAL_WINDOW_SIZE */
+	uint32_t peer_max_frame;
+	int want_write; /* -1 if the poller registration is unknown */
+	int draining; /* After GOAWAY or running out of stream ids: no new streams, close when idle */
+	struct dynbuf header_prefix; /* HPACK encoded pseudo-headers common to all requests */
+};
+
+static struct h2_conn *h2_conns;
+static unsigned int num_h2_conns;
+static unsigned int max_streams;
+static unsigned int streams_in_flight;
+static unsigned int no_stream_conns; /* Since a stream last completed */
+static uint32_t window;
+static const char *query_prefix;
+static const char *header;
+static struct dynbuf extra_header;
+static struct dynbuf request_block; /* The header block of the request being submitted */
+static int use_post;
+
+static int h2_handle_connected(struct expdecay *, struct conn_info *);
+static int h2_handle_io(struct expdecay *, struct conn_info *);
+
+/* Frame and HPACK encoding */
+
+static void
+put_bytes(struct dynbuf *d, const void *p, size_t len)
+{
+	dynbuf_ensure_space(d, len);
+	memcpy(d->buffer + d->pos, p, len);
+	d->pos += len;
+}
+
+static void
+put_u8(struct dynbuf *d, uint8_t v)
+{
+	put_bytes(d, &v, 1);
+}
+
+static void
+put_u32(struct dynbuf *d, uint32_t v)
+{
+	uint8_t b[4] = { v >> 24, v >> 16, v >> 8, v };
+	put_bytes(d, b, 4);
+}
+
+static void
+put_frame_header(struct dynbuf *d, uint32_t len, uint8_t type, uint8_t flags, uint32_t stream)
+{
+	uint8_t b[FRAME_HEADER_LEN] = {
+		len >> 16, len >> 8, len, type, flags,
+		stream >> 24, stream >> 16, stream >> 8, stream
+	};
+	put_bytes(d, b, sizeof b);
+}
+
+static void
+put_setting(struct dynbuf *d, uint16_t id, uint32_t value)
+{
+	put_u8(d, id >> 8);
+	put_u8(d, id);
+	put_u32(d, value);
+}
+
+/* RFC 7541 5.1 integer with an n bit prefix, first holds the bits above it */
+static void
+hpack_int(struct dynbuf *d, uint8_t first, int prefix_bits, uint32_t value)
+{
+	uint32_t max = (1 << prefix_bits) - 1;
+	if (value < max) {
+		put_u8(d, first | value);
+		return;
+	}
+	put_u8(d, first | max);
+	value -= max;
+	while (value >= 0x80) {
+		put_u8(d, 0x80 | (value & 0x7f));
+		value >>= 7;
+	}
+	put_u8(d, value);
+}
+
+/* String literal, never Huffman coded */
+static void
+hpack_string(struct dynbuf *d, const char *s, size_t len)
+{
+	hpack_int(d, 0, 7, len);
+	put_bytes(d, s, len);
+}
+
+/* Literal header field without indexing, with the name from static table index */
+static void
+hpack_indexed_name(struct dynbuf *d, unsigned int index, const char *value, size_t len)
+{
+	hpack_int(d, 0x00, 4, index);
+	hpack_string(d, value, len);
+}
+
+enum {
+	HPACK_AUTHORITY = 1,
+	HPACK_METHOD_GET = 2,
+	HPACK_METHOD_POST = 3,
+	HPACK_PATH = 4,
+	HPACK_SCHEME_HTTP = 6,
+	HPACK_CONTENT_LENGTH = 28,
+};
+
+static void
+build_header_prefix(struct h2_conn *h2c)
+{
+	struct dynbuf *d = &h2c->header_prefix;
+	const char *host = h2c->target->hostname;
+
+	dynbuf_init(d);
+	hpack_int(d, 0x80, 7, use_post ? HPACK_METHOD_POST : HPACK_METHOD_GET);
+	hpack_int(d, 0x80, 7, HPACK_SCHEME_HTTP);
+	hpack_indexed_name(d, HPACK_AUTHORITY, host, strlen(host));
+}
+
+/* The -H header, as a literal with a new name. It has to come after all the
+   pseudo-headers, and HTTP/2 wants lower case names. */
+static void
+build_extra_header(void)
+{
+	struct dynbuf *d = &extra_header;
+	const char *colon = strchr(header, ':');
+
+	dynbuf_init(d);
+	if (colon) {
+		size_t name_len = colon - header, n;
+		char *name = alloca(name_len);
+		const char *value = colon + 1;
+		for (n = 0; n < name_len; n++)
+			name[n] = tolower((unsigned char)header[n]);
+		while (*value == ' ')
+			value++;
+		hpack_int(d, 0x00, 4, 0);
+		hpack_string(d, name, name_len);
+		hpack_string(d, value, strlen(value));
+	}
+}
+
+/* Decoding. We ask the server for a header table size of 0, so only the
+   static table is in play, and all we need from a response is :status,
+   which is always the first field. */
+
+static int
+hpack_decode_int(const uint8_t **p, const uint8_t *end, int prefix_bits, uint32_t *value)
+{
+	uint32_t max = (1 << prefix_bits) - 1;
+	uint32_t v;
+	int shift = 0;
+
+	if (*p >= end)
+		return -1;
+	v = *(*p)++ & max;
+	if (v < max) {
+		*value = v;
+		return 0;
+	}
+	while (*p < end && shift <= 28) {
+		uint8_t b = *(*p)++;
+		v += (uint32_t)(b & 0x7f) << shift;
+		shift += 7;
+		if (!(b & 0x80)) {
+			*value = v;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/* Huffman decoding of a status code. The digits have the codes 00000-00010
+   for 0-2 and 011001-011111 for 3-9 (RFC 7541 appendix B). */
+static int
+huffman_status(const uint8_t *p, size_t len)
+{
+	uint32_t bits = 0;
+	int nbits = 0, digits, status = 0;
+	size_t i = 0;
+
+	for (digits = 0; digits < 3; digits++) {
+		while (nbits < 6 && i < len) {
+			bits = (bits << 8) | p[i++];
+			nbits += 8;
+		}
+		if (nbits < 5)
+			return -1;
+		uint32_t code = (bits >> (nbits - 5)) & 0x1f;
+		int digit;
+		if (code <= 2) {
+			digit = code;
+			nbits -= 5;
+		} else {
+			if (nbits < 6)
+				return -1;
+			code = (bits >> (nbits - 6)) & 0x3f;
+			if (code < 0x19 || code > 0x1f)
+				return -1;
+			digit = 3 + code - 0x19;
+			nbits -= 6;
+		}
+		bits &= (1 << nbits) - 1;
+		status = status * 10 + digit;
+	}
+	return status;
+}
+
+static int
+decode_status(const uint8_t *p, size_t len)
+{
+	static const int static_status[] = { 200, 204, 206, 304, 400, 404, 500 };
+	const uint8_t *end = p + len;
+	uint32_t index, value_len;
+
+	while (p < end) {
+		if (*p & 0x80) {
+			if (hpack_decode_int(&p, end, 7, &index) || index < 8 || index > 14)
+				return -1;
+			return static_status[index - 8];
+		}
+		if ((*p & 0xe0) == 0x20) {
+			/* Dynamic table size update */
+			if (hpack_decode_int(&p, end, 5, &index))
+				return -1;
+			continue;
+		}
+		int prefix = (*p & 0xc0) == 0x40 ? 6 : 4;
+		if (hpack_decode_int(&p, end, prefix, &index) || index < 8 || index > 14)
+			return -1;
+		if (p >= end)
+			return -1;
+		int huffman = *p & 0x80;
+		if (hpack_decode_int(&p, end, 7, &value_len) || value_len > (size_t)(end - p))
+			return -1;
+		if (huffman)
+			return huffman_status(p, value_len);
+		if (value_len != 3 || !isdigit(p[0]) || !isdigit(p[1]) || !isdigit(p[2]))
+			return -1;
+		return (p[0] - '0') * 100 + (p[1] - '0') * 10 + (p[2] - '0');
+	}
+	return -1;
+}
+
+/* Streams */
+
+static unsigned int
+stream_limit(const struct h2_conn *h2c)
+{
+	return h2c->peer_max_streams < max_streams ? h2c->peer_max_streams : max_streams;
+}
+
+static struct h2_stream *
+find_stream(struct h2_conn *h2c, uint32_t id)
+{
+	struct h2_stream *s = &h2c->streams[(id >> 1) % max_streams];
+	return id && s->id == id ? s : NULL;
+}
+
+static void
+release_stream(struct h2_conn *h2c, struct h2_stream *s)
+{
+	s->info.target->outstanding--;
+	dynbuf_free(&s->info.data);
+	dynbuf_free(&s->body);
+	s->id = 0;
+	h2c->num_active--;
+	streams_in_flight--;
+}
+
+static void
+stream_failed(struct h2_conn *h2c, struct h2_stream *s, enum result_class result)
+{
+	debug("h2 stream %u failed: %s\n", s->id, result_class_name(result));
+	query_failed(&s->info, result);
+	release_stream(h2c, s);
+}
+
+static void
+stream_done(struct expdecay *query_stats, struct h2_conn *h2c, struct h2_stream *s)
+{
+	s->info.finished_result_time = now();
+	dynbuf_ensure_space(&s->info.data, 1);
+	s->info.data.buffer[s->info.data.pos] = 0;
+	no_stream_conns = 0;
+	query_done(query_stats, &s->info, s->http_status ? s->http_status : -1);
+	release_stream(h2c, s);
+}
+
+/* Connections */
+
+static void
+conn_close(struct h2_conn *h2c, enum result_class result)
+{
+	struct conn_info *conn = h2c->conn;
+	unsigned int n;
+
+	for (n = 0; h2c->num_active && n < max_streams; n++) {
+		if (h2c->streams[n].id)
+			stream_failed(h2c, &h2c->streams[n], result);
+	}
+	debug("closing h2 connection on fd %d\n", conn->fd);
+	conn->status = CONN_UNUSED;
+	unregister_wait(conn);
+	close(conn->fd);
+	count_syscall(SC_CLOSE);
+	h2c->conn = NULL;
+	h2c->out.pos = h2c->out_sent = 0;
+	h2c->in.pos = 0;
+	h2c->header_block.pos = 0;
+	h2c->header_stream = 0;
+}
+
+static int
+conn_open(struct h2_conn *h2c)
+{
+	struct conn_info *conn = open_connection(h2c->target);
+	if (!conn)
+		return -1;
+	conn->handler = h2_handle_connected;
+	conn->h2 = h2c;
+	h2c->conn = conn;
+	h2c->next_stream_id = 1;
+	h2c->peer_max_streams = UINT32_MAX; /* Until the server tells us */
+	h2c->recv_unacked = 0;
+	h2c->send_window = DEFAULT_WINDOW;
+	h2c->peer_initial_window = DEFAULT_WINDOW;
+	h2c->peer_max_frame = DEFAULT_MAX_FRAME;
+	h2c->want_write = -1;
+	h2c->draining = 0;
+
+	put_bytes(&h2c->out, preface, sizeof preface - 1);
+	put_frame_header(&h2c->out, 3 * 6, FRAME_SETTINGS, 0, 0);
+	put_setting(&h2c->out, SETTINGS_HEADER_TABLE_SIZE, 0);
+	put_setting(&h2c->out, SETTINGS_ENABLE_PUSH, 0);
+	put_setting(&h2c->out, SETTINGS_INITIAL_WINDOW_SIZE, window);
+	if (window > DEFAULT_WINDOW) {
+		put_frame_header(&h2c->out, 4, FRAME_WINDOW_UPDATE, 0, 0);
+		put_u32(&h2c->out, window - DEFAULT_WINDOW);
+	}
+	wait_for_connected(conn);
+	return 0;
+}
+
+static int
+conn_flush(struct h2_conn *h2c)
+{
+	struct conn_info *conn = h2c->conn;
+
+	if (conn->status == CONN_CONNECTING)
+		return 0;
+	while (h2c->out_sent < h2c->out.pos) {
+		ssize_t written = write(conn->fd, h2c->out.buffer + h2c->out_sent,
+					h2c->out.pos - h2c->out_sent);
+		count_syscall(SC_WRITE);
+		if (written == -1) {
+			if (errno == EWOULDBLOCK || errno == EAGAIN)
+				return 0;
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "Write to h2 fd %d fails: %s\n", conn->fd, strerror(errno));
+			return -1;
+		}
+		h2c->out_sent += written;
+	}
+	h2c->out.pos = h2c->out_sent = 0;
+	return 0;
+}
+
+static void
+conn_update_interest(struct h2_conn *h2c)
+{
+	int want_write = h2c->out_sent < h2c->out.pos;
+	if (want_write == h2c->want_write)
+		return;
+	if (want_write)
+		wait_for_read_write(h2c->conn);
+	else
+		wait_for_read(h2c->conn);
+	h2c->want_write = want_write;
+}
+
+static void
+send_window_update(struct h2_conn *h2c, uint32_t stream, uint32_t *unacked)
+{
+	if (*unacked < window / 2)
+		return;
+	put_frame_header(&h2c->out, 4, FRAME_WINDOW_UPDATE, 0, stream);
+	put_u32(&h2c->out, *unacked);
+	*unacked = 0;
+}
+
+static uint32_t
+get_u32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+/* Send as much of the body as both of the server's windows allow. The rest
+   waits for a WINDOW_UPDATE. */
+static void
+send_body(struct h2_conn *h2c, struct h2_stream *s)
+{
+	size_t len = s->body.pos;
+
+	while (s->body_pending) {
+		int64_t chunk = len - s->body_sent;
+		if (chunk > h2c->peer_max_frame)
+			chunk = h2c->peer_max_frame;
+		if (chunk > h2c->send_window)
+			chunk = h2c->send_window;
+		if (chunk > s->send_window)
+			chunk = s->send_window;
+		if (chunk <= 0 && s->body_sent < len)
+			return;
+		if (chunk < 0)
+			chunk = 0; /* An empty body needs no window */
+		s->body_sent += chunk;
+		s->body_pending = s->body_sent < len;
+		put_frame_header(&h2c->out, chunk, FRAME_DATA,
+				 s->body_pending ? 0 : FLAG_END_STREAM, s->id);
+		put_bytes(&h2c->out, s->body.buffer + s->body_sent - chunk, chunk);
+		h2c->send_window -= chunk;
+		s->send_window -= chunk;
+	}
+}
+
+/* A header block goes out as HEADERS plus as many CONTINUATION frames as the
+   server's frame size calls for. Nothing may come between them. */
+static void
+send_header_block(struct h2_conn *h2c, uint32_t id, const struct dynbuf *block, int end_stream)
+{
+	uint8_t type = FRAME_HEADERS;
+	uint8_t flags = end_stream ? FLAG_END_STREAM : 0;
+	size_t sent = 0;
+
+	do {
+		size_t chunk = block->pos - sent;
+		if (chunk > h2c->peer_max_frame)
+			chunk = h2c->peer_max_frame;
+		if (sent + chunk == block->pos)
+			flags |= FLAG_END_HEADERS;
+		put_frame_header(&h2c->out, chunk, type, flags, id);
+		put_bytes(&h2c->out, block->buffer + sent, chunk);
+		sent += chunk;
+		type = FRAME_CONTINUATION;
+		flags = 0;
+	} while (sent < block->pos);
+}
+
+static void
+send_pending_bodies(struct h2_conn *h2c)
+{
+	unsigned int n;
+
+	for (n = 0; n < max_streams && h2c->send_window > 0; n++) {
+		if (h2c->streams[n].id)
+			send_body(h2c, &h2c->streams[n]);
+	}
+}
+
+/* Remove padding and priority fields from a DATA or HEADERS payload */
+static int
+strip_payload(uint8_t flags, const uint8_t **payload, uint32_t *len, int has_priority)
+{
+	uint32_t pad = 0;
+	if (flags & FLAG_PADDED) {
+		if (*len < 1)
+			return -1;
+		pad = (*payload)[0];
+		(*payload)++;
+		(*len)--;
+	}
+	if (has_priority && (flags & FLAG_PRIORITY)) {
+		if (*len < 5)
+			return -1;
+		*payload += 5;
+		*len -= 5;
+	}
+	if (pad > *len)
+		return -1;
+	*len -= pad;
+	return 0;
+}
+
+static void
+headers_complete(struct expdecay *query_stats, struct h2_conn *h2c, struct h2_stream *s,
+		 const uint8_t *block, size_t len, int end_stream)
+{
+	if (!s->info.first_result_time)
+		s->info.first_result_time = now();
+	if (!s->http_status) {
+		int status = decode_status(block, len);
+		if (status < 100 || status > 199) /* Wait for the final status after 1xx */
+			s->http_status = status;
+		debug("h2 stream %u status %d\n", s->id, status);
+	}
+	if (end_stream)
+		stream_done(query_stats, h2c, s);
+}
+
+static void
+handle_frame(struct expdecay *query_stats, struct h2_conn *h2c, uint8_t type, uint8_t flags,
+	     uint32_t stream, const uint8_t *payload, uint32_t len)
+{
+	struct h2_stream *s = find_stream(h2c, stream);
+	uint32_t frame_len = len;
+
+	spam("h2 frame type %u flags 0x%x stream %u len %u\n", type, flags, stream, len);
+	switch (type) {
+	case FRAME_DATA:
+		h2c->recv_unacked += frame_len;
+		send_window_update(h2c, 0, &h2c->recv_unacked);
+		if (!s)
+			break;
+		if (strip_payload(flags, &payload, &len, 0)) {
+			stream_failed(h2c, s, RESULT_BAD_RESPONSE);
+			break;
+		}
+		if (!s->info.first_result_time)
+			s->info.first_result_time = now();
+		put_bytes(&s->info.data, payload, len);
+		if (hashing_responses)
+			response_hash_update(&s->info, 0, s->info.data.pos); /* data is only the body */
+		if (flags & FLAG_END_STREAM) {
+			stream_done(query_stats, h2c, s);
+		} else {
+			s->recv_unacked += frame_len;
+			send_window_update(h2c, stream, &s->recv_unacked);
+		}
+		break;
+	case FRAME_HEADERS:
+		if (strip_payload(flags, &payload, &len, 1)) {
+			if (s)
+				stream_failed(h2c, s, RESULT_BAD_RESPONSE);
+			break;
+		}
+		if (flags & FLAG_END_HEADERS) {
+			if (s)
+				headers_complete(query_stats, h2c, s, payload, len, flags & FLAG_END_STREAM);
+			break;
+		}
+		h2c->header_stream = stream;
+		h2c->header_end_stream = flags & FLAG_END_STREAM;
+		h2c->header_block.pos = 0;
+		put_bytes(&h2c->header_block, payload, len);
+		break;
+	case FRAME_CONTINUATION:
+		if (stream != h2c->header_stream)
+			break;
+		put_bytes(&h2c->header_block, payload, len);
+		if (flags & FLAG_END_HEADERS) {
+			h2c->header_stream = 0;
+			if (s) {
+				headers_complete(query_stats, h2c, s,
+						 (const uint8_t *)h2c->header_block.buffer,
+						 h2c->header_block.pos, h2c->header_end_stream);
+			}
+		}
+		break;
+	case FRAME_RST_STREAM:
+		if (s) {
+			debug("h2 stream %u reset by server, error %u\n", stream,
+			      len >= 4 ? get_u32(payload) : 0);
+			stream_failed(h2c, s, RESULT_READ_ERROR);
+		}
+		break;
+	case FRAME_SETTINGS:
+		if (flags & FLAG_ACK)
+			break;
+		for (; len >= 6; payload += 6, len -= 6) {
+			uint16_t id = payload[0] << 8 | payload[1];
+			uint32_t value = get_u32(payload + 2);
+			unsigned int n;
+			if (id == SETTINGS_MAX_CONCURRENT_STREAMS) {
+				h2c->peer_max_streams = value;
+				debug("h2 server allows %u concurrent streams\n", h2c->peer_max_streams);
+				if (!value && !h2c->draining) {
+					/* Legal, but nothing could ever be sent here again */
+					if (++no_stream_conns >= MAX_NO_STREAM_CONNS) {
+						fprintf(stderr, "The HTTP/2 server allows no concurrent "
+							"streams, giving up\n");
+						exit(EXIT_FAILURE);
+					}
+					fprintf(stderr, "HTTP/2 server allows no concurrent streams on "
+						"fd %d, reconnecting\n", h2c->conn->fd);
+					h2c->draining = 1;
+				}
+			} else if (id == SETTINGS_INITIAL_WINDOW_SIZE && value <= MAX_STREAM_ID) {
+				/* Applies to the streams already open too (RFC 7540 6.9.2) */
+				for (n = 0; n < max_streams; n++) {
+					if (h2c->streams[n].id)
+						h2c->streams[n].send_window += (int64_t)value
+							- h2c->peer_initial_window;
+				}
+				h2c->peer_initial_window = value;
+			} else if (id == SETTINGS_MAX_FRAME_SIZE && value >= DEFAULT_MAX_FRAME
+				   && value <= 0xffffff) {
+				h2c->peer_max_frame = value;
+			}
+		}
+		put_frame_header(&h2c->out, 0, FRAME_SETTINGS, FLAG_ACK, 0);
+		send_pending_bodies(h2c);
+		break;
+	case FRAME_WINDOW_UPDATE:
+		if (len != 4)
+			break;
+		if (!stream) {
+			h2c->send_window += get_u32(payload) & MAX_STREAM_ID;
+			send_pending_bodies(h2c);
+		} else if (s) {
+			s->send_window += get_u32(payload) & MAX_STREAM_ID;
+			send_body(h2c, s);
+		}
+		break;
+	case FRAME_PING:
+		if (!(flags & FLAG_ACK) && len == 8) {
+			put_frame_header(&h2c->out, 8, FRAME_PING, FLAG_ACK, 0);
+			put_bytes(&h2c->out, payload, 8);
+		}
+		break;
+	case FRAME_GOAWAY:
+		if (len >= 8) {
+			uint32_t last_stream = get_u32(payload) & MAX_STREAM_ID;
+			unsigned int n;
+			debug("h2 GOAWAY, last stream %u, error %u\n", last_stream, get_u32(payload + 4));
+			h2c->draining = 1;
+			for (n = 0; n < max_streams; n++) {
+				if (h2c->streams[n].id > last_stream)
+					stream_failed(h2c, &h2c->streams[n], RESULT_READ_ERROR);
+			}
+		}
+		break;
+	default:
+		/* PRIORITY and anything unknown */
+		break;
+	}
+}
+
+static int
+h2_handle_connected(struct expdecay *query_stats, struct conn_info *conn)
+{
+	struct h2_conn *h2c = conn->h2;
+	unsigned int n;
+
+	conn->status = CONN_CONNECTED;
+	conn->connected_time = now();
+	debug("h2 connection on fd %d connected\n", conn->fd);
+	for (n = 0; n < max_streams; n++) {
+		if (h2c->streams[n].id)
+			h2c->streams[n].info.connected_time = conn->connected_time;
+	}
+	conn->handler = h2_handle_io;
+	return h2_handle_io(query_stats, conn);
+}
+
+static int
+h2_handle_io(struct expdecay *query_stats, struct conn_info *conn)
+{
+	struct h2_conn *h2c = conn->h2;
+	ssize_t len;
+
+	if (conn_flush(h2c)) {
+		conn_close(h2c, RESULT_WRITE_ERROR);
+		return -1;
+	}
+
+	do {
+		dynbuf_ensure_space(&h2c->in, BYTES_PER_NETWORK_READ);
+		len = read(conn->fd, h2c->in.buffer + h2c->in.pos, BYTES_PER_NETWORK_READ);
+		count_syscall(SC_READ);
+		if (len > 0)
+			h2c->in.pos += len;
+	} while (len > 0);
+	int saved_errno = errno;
+
+	const uint8_t *p = (const uint8_t *)h2c->in.buffer;
+	size_t pos = 0;
+	while (h2c->in.pos - pos >= FRAME_HEADER_LEN) {
+		uint32_t frame_len = p[pos] << 16 | p[pos + 1] << 8 | p[pos + 2];
+		if (h2c->in.pos - pos < FRAME_HEADER_LEN + frame_len)
+			break;
+		handle_frame(query_stats, h2c, p[pos + 3], p[pos + 4],
+			     get_u32(p + pos + 5) & MAX_STREAM_ID, p + pos + FRAME_HEADER_LEN,
+			     frame_len);
+		pos += FRAME_HEADER_LEN + frame_len;
+	}
+	memmove(h2c->in.buffer, h2c->in.buffer + pos, h2c->in.pos - pos);
+	h2c->in.pos -= pos;
+
+	if (len == 0 || (len == -1 && saved_errno != EWOULDBLOCK && saved_errno != EINTR)) {
+		if (len == -1)
+			fprintf(stderr, "Read error on h2 fd %d: %s\n", conn->fd, strerror(saved_errno));
+		conn_close(h2c, RESULT_READ_ERROR);
+		return -1;
+	}
+	if (h2c->draining && !h2c->num_active) {
+		conn_close(h2c, RESULT_OK); /* Opened again by the next h2_submit() */
+		return 0;
+	}
+	if (conn_flush(h2c)) {
+		conn_close(h2c, RESULT_WRITE_ERROR);
+		return -1;
+	}
+	conn_update_interest(h2c);
+	return 1;
+}
+
+/* The interface towards the main loop */
+
+void
+h2_init(unsigned int num_connections, unsigned int streams, uint32_t window_size,
+	const char *prefix, const char *hdr, int post)
+{
+	unsigned int n;
+
+	num_h2_conns = num_connections;
+	max_streams = (streams + num_connections - 1) / num_connections;
+	window = window_size;
+	query_prefix = prefix;
+	header = hdr;
+	build_extra_header();
+	use_post = post;
+
+	h2_conns = calloc(num_h2_conns, sizeof h2_conns[0]);
+	if (!h2_conns) {
+		fprintf(stderr, "Failed to allocate memory for h2 connections: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	for (n = 0; n < num_h2_conns; n++) {
+		struct h2_conn *h2c = &h2_conns[n];
+		h2c->target = &targets[n % num_targets];
+		h2c->streams = calloc(max_streams, sizeof h2c->streams[0]);
+		if (!h2c->streams) {
+			fprintf(stderr, "Failed to allocate memory for h2 streams: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		dynbuf_init(&h2c->out);
+		dynbuf_init(&h2c->in);
+		dynbuf_init(&h2c->header_block);
+		build_header_prefix(h2c);
+	}
+}
+
+/* Pick the open connection with the fewest active streams, or a closed one
+   to open if no open connection has room. */
+static struct h2_conn *
+pick_conn(void)
+{
+	struct h2_conn *best = NULL, *closed = NULL;
+	unsigned int n;
+
+	for (n = 0; n < num_h2_conns; n++) {
+		struct h2_conn *h2c = &h2_conns[n];
+		if (!h2c->conn) {
+			if (!closed)
+				closed = h2c;
+			continue;
+		}
+		if (h2c->draining || h2c->num_active >= stream_limit(h2c))
+			continue;
+		if (!best || h2c->num_active < best->num_active)
+			best = h2c;
+	}
+	return best ? best : closed;
+}
+
+int
+h2_can_submit(void)
+{
+	return pick_conn() != NULL;
+}
+
+void
+h2_submit(const struct query *q)
+{
+	const char *query = q->text;
+	struct h2_conn *h2c = pick_conn();
+	struct h2_stream *s;
+	uint32_t id;
+	char expanded[TEMPLATE_MAX_LEN];
+	uint64_t instance = 0;
+
+	rt_assert(h2c);
+	if (q->tmpl) {
+		instance = template_instance();
+		template_expand(q->tmpl, instance, expanded, sizeof expanded);
+		query = expanded;
+	}
+	if (!h2c->conn && conn_open(h2c) == -1)
+		return; /* The query is counted as a connect error */
+
+	/* Stream ids must increase but may be skipped, so skip ahead to one
+	   with a free slot. There is one since num_active < max_streams. */
+	for (id = h2c->next_stream_id; ; id += 2) {
+		s = &h2c->streams[(id >> 1) % max_streams];
+		if (!s->id)
+			break;
+	}
+	h2c->next_stream_id = id + 2;
+	if (h2c->next_stream_id + 2 * max_streams > MAX_STREAM_ID) {
+		/* Leave room for the skipping above, and go on with a fresh connection */
+		debug("h2 connection on fd %d is out of stream ids\n", h2c->conn->fd);
+		h2c->draining = 1;
+	}
+
+	memset(s, 0, sizeof *s);
+	s->id = id;
+	s->info.connect_time = now();
+	if (h2c->conn->status != CONN_CONNECTING)
+		s->info.connected_time = s->info.connect_time;
+	s->info.fd = h2c->conn->fd;
+	s->info.status = CONN_WAITING_RESULT;
+	s->info.query = q;
+	s->info.instance = instance;
+	s->info.warmup = warming_up;
+	s->info.target = h2c->target;
+	s->send_window = h2c->peer_initial_window;
+	dynbuf_init(&s->body);
+	dynbuf_init(&s->info.data);
+	http_response_init(&s->info.response);
+	if (hashing_responses)
+		response_hash_start(&s->info);
+	h2c->target->outstanding++;
+	if (!warming_up)
+		h2c->target->sent++;
+	h2c->num_active++;
+	streams_in_flight++;
+
+	/* The precomputed prefix and the path, then the body */
+	struct dynbuf *out = &request_block;
+	size_t prefix_len = strlen(query_prefix);
+	size_t query_len = strlen(query);
+	char length[24];
+	out->pos = 0;
+	put_bytes(out, h2c->header_prefix.buffer, h2c->header_prefix.pos);
+	if (use_post) {
+		/* :path must not be empty, unlike the HTTP/1 request line */
+		if (prefix_len)
+			hpack_indexed_name(out, HPACK_PATH, query_prefix, prefix_len);
+		else
+			hpack_indexed_name(out, HPACK_PATH, "/", 1);
+		snprintf(length, sizeof length, "%zu", query_len);
+		hpack_indexed_name(out, HPACK_CONTENT_LENGTH, length, strlen(length));
+	} else {
+		char *path = alloca(prefix_len + query_len);
+		memcpy(path, query_prefix, prefix_len);
+		memcpy(path + prefix_len, query, query_len);
+		hpack_indexed_name(out, HPACK_PATH, path, prefix_len + query_len);
+	}
+	put_bytes(out, extra_header.buffer, extra_header.pos);
+	send_header_block(h2c, id, out, !use_post);
+
+	if (use_post) {
+		/* Kept, as a template expansion does not outlive this call */
+		put_bytes(&s->body, query, query_len);
+		s->body_pending = 1;
+		send_body(h2c, s);
+	}
+	debug("h2 stream %u on fd %d: %s\n", id, h2c->conn->fd, query);
+}
+
+void
+h2_flush(void)
+{
+	unsigned int n;
+
+	for (n = 0; n < num_h2_conns; n++) {
+		struct h2_conn *h2c = &h2_conns[n];
+		if (!h2c->conn || h2c->conn->status == CONN_CONNECTING)
+			continue;
+		if (conn_flush(h2c)) {
+			conn_close(h2c, RESULT_WRITE_ERROR);
+			continue;
+		}
+		conn_update_interest(h2c);
+	}
+}
+
+unsigned int
+h2_streams_in_flight(void)
+{
+	return streams_in_flight;
+}
+
+void
+h2_close_idle(void)
+{
+	unsigned int n;
+
+	for (n = 0; n < num_h2_conns; n++) {
+		if (h2_conns[n].conn && !h2_conns[n].num_active)
+			conn_close(&h2_conns[n], RESULT_OK);
+	}
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
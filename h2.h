@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef H2_H
+#define H2_H
+
+/* HTTP/2 over cleartext TCP with prior knowledge (h2c). Queries are sent
+ * as concurrent streams over a few long lived connections instead of one
+ * connection per query. Each stream is tracked in its own conn_info record
+ * so it is logged and accounted exactly like a HTTP/1 query. */
+
+#include <stdint.h>
+
+struct query;
+
+void h2_init(unsigned int num_connections, unsigned int max_streams, uint32_t window,
+	     const char *query_prefix, const char *header, int use_post);
+int h2_can_submit(void);
+void h2_submit(const struct query *query);
+void h2_flush(void); /* Send everything submitted since last time */
+unsigned int h2_streams_in_flight(void);
+void h2_close_idle(void);
+
+#endif /* !H2_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
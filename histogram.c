@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "histogram.h"
+
+enum { HALF = HISTOGRAM_SUB_BUCKETS / 2 };
+
+void
+histogram_init(struct histogram *h)
+{
+	memset(h, 0, sizeof *h);
+}
+
+static unsigned int
+bucket_index(uint64_t us)
+{
+	if (us < HISTOGRAM_SUB_BUCKETS)
+		return us;
+
+	/* Keep the top HISTOGRAM_SUB_BITS + 1 bits of the value */
+	unsigned int shift = 63 - __builtin_clzll(us) - HISTOGRAM_SUB_BITS;
+	unsigned int idx = HISTOGRAM_SUB_BUCKETS + (shift - 1) * HALF + (us >> shift) - HALF;
+	return idx < HISTOGRAM_BUCKETS ? idx : HISTOGRAM_BUCKETS - 1;
+}
+
+/* The value in the middle of bucket idx, in microseconds */
+static double
+bucket_value(unsigned int idx)
+{
+	if (idx < HISTOGRAM_SUB_BUCKETS)
+		return idx;
+
+	unsigned int shift = (idx - HISTOGRAM_SUB_BUCKETS) / HALF + 1;
+	uint64_t base = (uint64_t)((idx - HISTOGRAM_SUB_BUCKETS) % HALF + HALF) << shift;
+	return base + ((uint64_t)1 << shift) / 2.0;
+}
+
+void
+histogram_record(struct histogram *h, double seconds)
+{
+	if (seconds < 0)
+		seconds = 0;
+	h->buckets[bucket_index((uint64_t)(seconds * 1e6))]++;
+	if (!h->count || seconds < h->min)
+		h->min = seconds;
+	if (seconds > h->max)
+		h->max = seconds;
+	h->count++;
+	h->sum += seconds;
+}
+
+void
+histogram_merge(struct histogram *dst, const struct histogram *src)
+{
+	unsigned int n;
+
+	if (!src->count)
+		return;
+	for (n = 0; n < HISTOGRAM_BUCKETS; n++)
+		dst->buckets[n] += src->buckets[n];
+	if (!dst->count || src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	dst->count += src->count;
+	dst->sum += src->sum;
+}
+
+double
+histogram_mean(const struct histogram *h)
+{
+	return h->count ? h->sum / h->count : 0;
+}
+
+double
+histogram_percentile(const struct histogram *h, double percentile)
+{
+	if (!h->count)
+		return 0;
+
+	uint64_t wanted = (uint64_t)(percentile / 100.0 * h->count + 0.5);
+	uint64_t seen = 0;
+	unsigned int n;
+
+	if (wanted < 1)
+		wanted = 1;
+	if (wanted >= h->count)
+		return h->max;
+	for (n = 0; n < HISTOGRAM_BUCKETS; n++) {
+		seen += h->buckets[n];
+		if (seen >= wanted) {
+			double value = 1e-6 * bucket_value(n);
+			/* Never report outside what was actually recorded */
+			return value < h->min ? h->min : value > h->max ? h->max : value;
+		}
+	}
+	return h->max;
+}
+
+uint64_t
+histogram_count_below(const struct histogram *h, double seconds)
+{
+	/* Everything in the buckets before the one seconds falls in */
+	unsigned int last = bucket_index((uint64_t)(seconds * 1e6));
+	uint64_t count = 0;
+	unsigned int n;
+
+	for (n = 0; n < last; n++)
+		count += h->buckets[n];
+	return count;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
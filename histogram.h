@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+/* Latency histogram with log-linear buckets, in the style of HdrHistogram.
+ * Values are recorded in microseconds with about 3% precision, from 1us up
+ * to several hours. Recording is a few shifts and an increment. */
+
+#include <stdint.h>
+
+enum {
+	HISTOGRAM_SUB_BITS = 5,
+	HISTOGRAM_SUB_BUCKETS = 1 << (HISTOGRAM_SUB_BITS + 1),
+	HISTOGRAM_BUCKETS = HISTOGRAM_SUB_BUCKETS + 31 * (HISTOGRAM_SUB_BUCKETS / 2),
+};
+
+struct histogram {
+	uint64_t count;
+	double sum; /* seconds */
+	double min;
+	double max;
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+void histogram_init(struct histogram *);
+void histogram_record(struct histogram *, double seconds);
+void histogram_merge(struct histogram *dst, const struct histogram *src);
+double histogram_mean(const struct histogram *);
+double histogram_percentile(const struct histogram *, double percentile); /* 0..100 */
+uint64_t histogram_count_below(const struct histogram *, double seconds); /* Within a bucket */
+
+#endif /* !HISTOGRAM_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,248 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "http-response.h"
+
+enum { SCAN_BLOCK = 16 };
+
+enum chunk_state { CHUNK_SIZE, CHUNK_DATA, CHUNK_DATA_END, CHUNK_TRAILER, CHUNK_DONE,
+		   CHUNK_ERROR };
+
+void
+http_response_init(struct http_response *r)
+{
+	memset(r, 0, sizeof *r);
+	r->content_length = -1;
+}
+
+/* Return a bitmask with bit n set if p[n] is a newline */
+static inline uint32_t
+newline_mask(const char *p, size_t len)
+{
+	uint32_t mask = 0;
+#ifdef __SSE2__
+	if (len >= SCAN_BLOCK) {
+		__m128i v = _mm_loadu_si128((const __m128i *)p);
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+	}
+#endif
+	size_t n;
+	if (len > SCAN_BLOCK)
+		len = SCAN_BLOCK;
+	for (n = 0; n < len; n++)
+		mask |= (uint32_t)(p[n] == '\n') << n;
+	return mask;
+}
+
+static int
+header_is(const char *line, size_t len, const char *name, size_t name_len)
+{
+	return len > name_len && line[name_len] == ':'
+		&& strncasecmp(line, name, name_len) == 0;
+}
+
+#define HEADER_IS(line, len, name) header_is(line, len, name, sizeof name - 1)
+
+/* Return the offset of the header value in line, skipping leading whitespace */
+static size_t
+value_start(const char *line, size_t len, size_t name_len)
+{
+	size_t n = name_len + 1;
+	while (n < len && (line[n] == ' ' || line[n] == '\t'))
+		n++;
+	return n;
+}
+
+static int
+value_contains(const char *value, size_t len, const char *token)
+{
+	size_t token_len = strlen(token);
+	size_t n;
+	for (n = 0; n + token_len <= len; n++) {
+		if (strncasecmp(value + n, token, token_len) == 0)
+			return 1;
+	}
+	return 0;
+}
+
+static void
+scan_line(struct http_response *r, const char *buf, size_t start, size_t len)
+{
+	const char *line = buf + start;
+	size_t v;
+
+	/* Dispatch on the first character so most lines cost a single compare */
+	switch (line[0] | 0x20) {
+	case 'c':
+		if (HEADER_IS(line, len, "content-length")) {
+			long long cl = 0;
+			for (v = value_start(line, len, 14); v < len; v++) {
+				if (line[v] < '0' || line[v] > '9')
+					break;
+				cl = cl * 10 + (line[v] - '0');
+			}
+			r->content_length = cl;
+		} else if (HEADER_IS(line, len, "connection")) {
+			v = value_start(line, len, 10);
+			r->connection_close = value_contains(line + v, len - v, "close");
+		}
+		break;
+	case 't':
+		if (HEADER_IS(line, len, "transfer-encoding")) {
+			v = value_start(line, len, 17);
+			r->chunked = value_contains(line + v, len - v, "chunked");
+		}
+		break;
+	case 's':
+		if (!r->server_timing_len && HEADER_IS(line, len, "server-timing")) {
+			v = value_start(line, len, 13);
+			r->server_timing_off = start + v;
+			r->server_timing_len = len - v;
+		}
+		break;
+	}
+}
+
+size_t
+http_scan_headers(struct http_response *r, const char *buf, size_t len)
+{
+	size_t line_start = r->scan_pos;
+	size_t block;
+
+	if (r->header_len)
+		return r->header_len;
+
+	/* Find all the newlines a block at a time, and handle each line as its
+	   terminating newline turns up. */
+	for (block = line_start; block < len; block += SCAN_BLOCK) {
+		uint32_t mask = newline_mask(buf + block, len - block);
+		while (mask) {
+			size_t nl = block + __builtin_ctz(mask);
+			size_t line_len = nl - line_start;
+			mask &= mask - 1;
+
+			if (line_len && buf[nl - 1] == '\r')
+				line_len--;
+			if (line_len == 0 && r->num_lines) {
+				r->header_len = nl + 1;
+				r->scan_pos = nl + 1;
+				return r->header_len;
+			}
+			if (r->num_lines++)
+				scan_line(r, buf, line_start, line_len); /* Not the status line */
+			line_start = nl + 1;
+		}
+	}
+	r->scan_pos = line_start;
+	return 0;
+}
+
+/* Length of the line at buf[pos..len) with its newline, 0 if it is not all there */
+static size_t
+line_length(const char *buf, size_t pos, size_t len)
+{
+	const char *nl = memchr(buf + pos, '\n', len - pos);
+	return nl ? (size_t)(nl - (buf + pos)) + 1 : 0;
+}
+
+static int
+hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+	c |= 0x20;
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	return -1;
+}
+
+/* The chunk size, ignoring extensions. Returns -1 if there is none. */
+static int
+chunk_size(const char *line, size_t *size)
+{
+	int digits = 0, v;
+
+	*size = 0;
+	for (; (v = hex_value(*line)) != -1; line++, digits++) {
+		if (*size > SIZE_MAX >> 4)
+			return -1;
+		*size = *size << 4 | v;
+	}
+	return digits ? 0 : -1;
+}
+
+size_t
+http_dechunk(struct http_response *r, char *buf, size_t len)
+{
+	size_t pos, n;
+
+	if (r->body_end < r->header_len)
+		r->body_end = r->header_len;
+
+	/* buf[body_end..pos) is framing that has been taken out */
+	for (pos = r->body_end; pos < len; pos += n) {
+		if (r->chunk_state == CHUNK_DATA) {
+			n = len - pos < r->chunk_left ? len - pos : r->chunk_left;
+			memmove(buf + r->body_end, buf + pos, n);
+			r->body_end += n;
+			r->chunk_left -= n;
+			if (!r->chunk_left)
+				r->chunk_state = CHUNK_DATA_END;
+			continue;
+		}
+		if (r->chunk_state == CHUNK_DONE || r->chunk_state == CHUNK_ERROR)
+			break;
+		n = line_length(buf, pos, len);
+		if (!n)
+			break;
+		switch (r->chunk_state) {
+		case CHUNK_SIZE:
+			if (chunk_size(buf + pos, &r->chunk_left) == -1) {
+				r->chunk_state = CHUNK_ERROR; /* Leave the rest as it is */
+				goto out;
+			}
+			r->chunk_state = r->chunk_left ? CHUNK_DATA : CHUNK_TRAILER;
+			break;
+		case CHUNK_DATA_END:
+			r->chunk_state = CHUNK_SIZE;
+			break;
+		case CHUNK_TRAILER:
+			if (n == 1 || (n == 2 && buf[pos] == '\r')) {
+				r->chunk_state = CHUNK_DONE;
+				r->body_complete = 1;
+			}
+			break;
+		}
+	}
+out:
+	r->framing_bytes += pos - r->body_end;
+	memmove(buf + r->body_end, buf + pos, len - pos);
+	return r->body_end + len - pos;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
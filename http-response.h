@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+/* Scanner for HTTP response headers. The scanner can be called repeatedly
+ * as more data arrives, it continues where it left off. Header values are
+ * stored as offsets since the buffer may be moved by a realloc between
+ * calls. */
+
+#include <sys/types.h>
+
+struct http_response {
+	size_t scan_pos; /* Start of the first line not scanned yet */
+	size_t header_len; /* Length including the empty line, 0 until complete */
+	long long content_length; /* -1 if not given */
+	unsigned int num_lines;
+	unsigned int chunked : 1;
+	unsigned int connection_close : 1;
+	unsigned int body_complete : 1; /* The last chunk and the trailers are in */
+	unsigned int chunk_state : 3; /* Of http_dechunk() */
+	size_t server_timing_off;
+	size_t server_timing_len; /* 0 if not given */
+	size_t body_end; /* Of the decoded part of a chunked body */
+	size_t chunk_left; /* Data left in the current chunk */
+	size_t framing_bytes; /* Chunk framing removed so far */
+};
+
+void http_response_init(struct http_response *);
+
+/* Scan buf[0..len) for header lines. Returns the length of the headers
+   once the terminating empty line has been seen, 0 if more data is needed. */
+size_t http_scan_headers(struct http_response *, const char *buf, size_t len);
+
+/* Decode the chunked body in buf[header_len..len) in place, as it arrives.
+   Returns the new length of buf: the decoded body up to body_end, followed
+   by chunk framing that is not complete yet. */
+size_t http_dechunk(struct http_response *, char *buf, size_t len);
+
+/* Where the body in buf[0..len) ends, leaving out undecoded chunk framing */
+static inline size_t
+http_body_end(const struct http_response *r, size_t len)
+{
+	return r->chunked ? r->body_end : len;
+}
+
+#endif /* !HTTP_RESPONSE_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
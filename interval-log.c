@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include "interval-log.h"
+#include "connection-info.h"
+#include "stats.h"
+#include "histogram.h"
+#include "warmup.h"
+
+static FILE *log_file;
+static const char *log_filename;
+static double run_start, interval_start, offered;
+static int interval_warmup; /* The interval started during the warm-up */
+
+/* The counters at the start of the interval */
+static unsigned long last_sent, last_completed, last_errors;
+static unsigned long long last_bytes;
+
+static unsigned long
+errors_total(void)
+{
+	unsigned long errors = 0;
+	int rc;
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++) {
+		if (rc != RESULT_OK)
+			errors += run_stats.results[rc];
+	}
+	return errors;
+}
+
+void
+interval_log_open(const char *filename, double start, double offered_qps)
+{
+	log_file = fopen_above_connections(filename, "w");
+	if (!log_file) {
+		fprintf(stderr, "Cannot open '%s' for writing: %s\n", filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	log_filename = filename;
+	run_start = interval_start = start;
+	offered = offered_qps;
+	interval_warmup = warming_up;
+
+	time_t t = (time_t)start;
+	char date[64];
+	strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%SZ", gmtime(&t));
+	fprintf(log_file, "#[cxbench interval log]\n"
+		"#[StartTime: %.3f (seconds since epoch), %s]\n"
+		"#[Latencies are in ms, offered_qps is 0 when running as fast as possible]\n"
+		"#[errors and bytes_per_s leave out the warm-up]\n"
+		"start,length,sent,completed,errors,bytes_per_s,offered_qps,achieved_qps,"
+		"mean,p50,p90,p99,p99.9,max,warmup\n", start, date);
+}
+
+void
+interval_log_write(double end, unsigned long sent)
+{
+	const struct histogram *h = &run_stats.interval_latency;
+	double length = end - interval_start;
+	unsigned long completed = stats_total() + run_stats.warmup, errors = errors_total();
+
+	if (!log_file || length <= 0)
+		return;
+	fprintf(log_file, "%.3f,%.3f,%lu,%lu,%lu,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d\n",
+		interval_start - run_start, length, sent - last_sent, completed - last_completed,
+		errors - last_errors, (run_stats.response_bytes - last_bytes) / length, offered,
+		(completed - last_completed) / length, 1e3 * histogram_mean(h),
+		1e3 * histogram_percentile(h, 50), 1e3 * histogram_percentile(h, 90),
+		1e3 * histogram_percentile(h, 99), 1e3 * histogram_percentile(h, 99.9),
+		1e3 * h->max, interval_warmup);
+	/* Somebody is probably watching with tail -f */
+	fflush(log_file);
+
+	interval_start = end;
+	interval_warmup = warming_up;
+	last_sent = sent;
+	last_completed = completed;
+	last_errors = errors;
+	last_bytes = run_stats.response_bytes;
+}
+
+void
+interval_log_close(double end, unsigned long sent)
+{
+	if (!log_file)
+		return;
+	interval_log_write(end, sent);
+	if (ferror(log_file) | fclose(log_file)) {
+		fprintf(stderr, "Cannot write '%s': %s\n", log_filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	log_file = NULL;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
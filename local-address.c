@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "local-address.h"
+#include "debug.h"
+#include "syscall-stats.h"
+
+enum { MAX_BIND_ATTEMPTS = 16, TIME_WAIT_SECONDS = 60 };
+
+struct local_address {
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	int family;
+	unsigned int next_port; /* Offset into the port range */
+};
+
+static struct local_address *addresses;
+static unsigned int num_addresses;
+static unsigned int next_address;
+static unsigned int port_low, port_high; /* 0 means let the kernel pick */
+
+void
+local_address_add(const char *list)
+{
+	char *copy = strdup(list);
+	char *name, *save = NULL;
+
+	for (name = strtok_r(copy, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+		addresses = realloc(addresses, (num_addresses + 1) * sizeof addresses[0]);
+		if (!addresses) {
+			fprintf(stderr, "Failed to allocate memory for addresses: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		struct local_address *la = &addresses[num_addresses];
+		memset(la, 0, sizeof *la);
+
+		struct sockaddr_in *sin = (struct sockaddr_in *)&la->addr;
+		struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)&la->addr;
+		if (inet_pton(AF_INET, name, &sin->sin_addr) == 1) {
+			sin->sin_family = la->family = AF_INET;
+			la->addrlen = sizeof *sin;
+		} else if (inet_pton(AF_INET6, name, &sin6->sin6_addr) == 1) {
+			sin6->sin6_family = la->family = AF_INET6;
+			la->addrlen = sizeof *sin6;
+		} else {
+			fprintf(stderr, "Invalid bind address '%s', must be a numeric IP address\n", name);
+			exit(EXIT_FAILURE);
+		}
+		num_addresses++;
+	}
+	free(copy);
+}
+
+void
+local_ports_set(const char *range)
+{
+	char *end;
+	unsigned long low = strtoul(range, &end, 10), high;
+
+	if (*end != '-' || (high = strtoul(end + 1, &end, 10), *end)
+	    || low == 0 || low > high || high > 65535) {
+		fprintf(stderr, "Invalid port range '%s', expected <low>-<high>\n", range);
+		exit(EXIT_FAILURE);
+	}
+	port_low = low;
+	port_high = high;
+}
+
+void
+local_address_report(FILE *f)
+{
+	if (!port_low)
+		return;
+	unsigned int ports = port_high - port_low + 1;
+	unsigned int sources = num_addresses ? num_addresses : 1;
+	fprintf(f, "Local ports %u-%u on %u address%s: about %u connections/s per target "
+		"before ports in TIME_WAIT come around again\n", port_low, port_high,
+		sources, sources == 1 ? "" : "es", ports * sources / TIME_WAIT_SECONDS);
+}
+
+static void
+set_port(struct local_address *la, unsigned int port)
+{
+	if (la->family == AF_INET6)
+		((struct sockaddr_in6 *)&la->addr)->sin6_port = htons(port);
+	else
+		((struct sockaddr_in *)&la->addr)->sin_port = htons(port);
+}
+
+/* Without an address list, port range binding goes to the wildcard address */
+static struct local_address *
+wildcard_address(int family)
+{
+	static struct local_address wildcard[2];
+	struct local_address *la = &wildcard[family == AF_INET6];
+
+	if (!la->family) {
+		la->family = la->addr.ss_family = family;
+		la->addrlen = family == AF_INET6 ? sizeof(struct sockaddr_in6)
+			: sizeof(struct sockaddr_in);
+	}
+	return la;
+}
+
+static struct local_address *
+pick_address(int family)
+{
+	unsigned int n;
+
+	if (!num_addresses)
+		return wildcard_address(family);
+	for (n = 0; n < num_addresses; n++) {
+		struct local_address *la = &addresses[next_address++ % num_addresses];
+		if (la->family == family)
+			return la;
+	}
+	return NULL;
+}
+
+int
+local_address_bind(int fd, int family)
+{
+	const int one = 1;
+	unsigned int attempt;
+
+	if ((!num_addresses && !port_low) || (family != AF_INET && family != AF_INET6))
+		return 0;
+
+	struct local_address *la = pick_address(family);
+	if (!la) {
+		fprintf(stderr, "No bind address given for the %s target\n",
+			family == AF_INET6 ? "IPv6" : "IPv4");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!port_low) {
+#ifdef IP_BIND_ADDRESS_NO_PORT
+		/* Postpone the port choice to connect(), when the kernel knows the
+		   destination and can reuse a port that is busy towards other hosts */
+		setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof one);
+		count_syscall(SC_SETSOCKOPT);
+#endif
+		set_port(la, 0);
+		count_syscall(SC_BIND);
+		return bind(fd, (struct sockaddr *)&la->addr, la->addrlen);
+	}
+
+	/* Hand out the ports in order, so each one rests as long as possible
+	   before it is used again. SO_REUSEADDR lets us bind a port that still
+	   has a connection in TIME_WAIT; connect() refuses if that is towards
+	   the same destination. */
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+	count_syscall(SC_SETSOCKOPT);
+	for (attempt = 0; attempt < MAX_BIND_ATTEMPTS; attempt++) {
+		unsigned int port = port_low + la->next_port;
+		if (++la->next_port > port_high - port_low)
+			la->next_port = 0;
+		set_port(la, port);
+		count_syscall(SC_BIND);
+		if (bind(fd, (struct sockaddr *)&la->addr, la->addrlen) == 0)
+			return 0;
+		if (errno != EADDRINUSE)
+			return -1;
+		debug("local port %u busy\n", port);
+	}
+	return -1;
+}
+
+long
+tcp_time_wait_count(void)
+{
+	/* "TCP: inuse 5 orphan 0 tw 2 alloc 7 mem 1", for IPv4 and IPv6 together */
+	FILE *f = fopen("/proc/net/sockstat", "r");
+	char line[256];
+	long tw = -1;
+
+	if (!f)
+		return -1;
+	while (fgets(line, sizeof line, f)) {
+		const char *p;
+		if (strncmp(line, "TCP:", 4) == 0 && (p = strstr(line, " tw ")))
+			tw = strtol(p + 4, NULL, 10);
+	}
+	fclose(f);
+	return tw;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
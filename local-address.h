@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef LOCAL_ADDRESS_H
+#define LOCAL_ADDRESS_H
+
+/* Where our side of the connections comes from. With one connection per
+ * query, a single source address runs out of ephemeral ports towards a
+ * target after some 28k connections per TIME_WAIT period (60s on Linux). */
+
+void local_address_add(const char *list); /* Comma separated numeric addresses */
+void local_ports_set(const char *range); /* "low-high" */
+void local_address_report(FILE *);
+int local_address_bind(int fd, int family); /* 0, or -1 with errno set */
+long tcp_time_wait_count(void); /* -1 if unknown */
+
+#endif /* !LOCAL_ADDRESS_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
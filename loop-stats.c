@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <string.h>
+
+#include "loop-stats.h"
+#include "timeutil.h"
+
+/* The client is saturated when it uses this much of a CPU, or queries go
+   out this late */
+#define SATURATED_CPU 0.9
+#define SATURATED_LAG 0.01
+
+enum { WARN_EVERY = 10 }; /* Intervals between repeated warnings */
+
+struct loop_stats loop_stats;
+
+/* The current interval */
+static struct histogram send_lag;
+static unsigned long iterations, events, limited;
+static double busy, max_busy;
+static double last_wakeup;
+static double interval_start, interval_cpu;
+static unsigned int saturated_streak;
+
+static double
+cpu_seconds(void)
+{
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + 1e-6 * ru.ru_utime.tv_usec
+		+ ru.ru_stime.tv_sec + 1e-6 * ru.ru_stime.tv_usec;
+}
+
+void
+loop_stats_wakeup(int num_events)
+{
+	last_wakeup = now();
+	events += num_events;
+}
+
+void
+loop_stats_idle(void)
+{
+	if (!last_wakeup)
+		return;
+	double elapsed = now() - last_wakeup;
+	iterations++;
+	busy += elapsed;
+	if (elapsed > max_busy)
+		max_busy = elapsed;
+}
+
+void
+loop_stats_send(double lag)
+{
+	histogram_record(&send_lag, lag);
+}
+
+void
+loop_stats_limited(void)
+{
+	limited++;
+}
+
+void
+loop_stats_interval(char *progress, size_t len, unsigned int parallel)
+{
+	double t = now(), cpu = cpu_seconds();
+	double cpu_share = interval_start ? (cpu - interval_cpu) / (t - interval_start) : 0;
+
+	snprintf(progress, len, "lag p50/p99: %.2f/%.2fms  loop: %.0fus  ev/wake: %.1f  cpu: %3.0f%%",
+		 1e3 * histogram_percentile(&send_lag, 50), 1e3 * histogram_percentile(&send_lag, 99),
+		 iterations ? 1e6 * busy / iterations : 0, iterations ? (double)events / iterations : 0,
+		 100 * cpu_share);
+
+	/* Late queries with all -p slots busy means the server (or -p) is the
+	   limit, not us */
+	double lag = histogram_percentile(&send_lag, 99);
+	int behind = interval_start && (cpu_share >= SATURATED_CPU || lag >= SATURATED_LAG);
+	if (behind && !limited)
+		loop_stats.saturated_intervals++;
+	if (behind && saturated_streak++ % WARN_EVERY == 0) {
+		if (limited)
+			fprintf(stderr, "\nWARNING: queries sent up to %.2fms late (p99), all %u -p slots "
+				"were busy. Raise -p, or the server cannot keep up with the rate\n",
+				1e3 * lag, parallel);
+		else
+			fprintf(stderr, "\nWARNING: cxbench cannot keep up: %.0f%% CPU, queries sent up "
+				"to %.2fms late (p99). The latencies include client delays\n",
+				100 * cpu_share, 1e3 * lag);
+	}
+	if (!behind)
+		saturated_streak = 0;
+
+	histogram_merge(&loop_stats.send_lag, &send_lag);
+	loop_stats.iterations += iterations;
+	loop_stats.busy += busy;
+	if (max_busy > loop_stats.max_busy)
+		loop_stats.max_busy = max_busy;
+	loop_stats.events += events;
+	loop_stats.intervals++;
+
+	histogram_init(&send_lag);
+	iterations = events = limited = 0;
+	busy = max_busy = 0;
+	interval_start = t;
+	interval_cpu = cpu;
+}
+
+double
+loop_stats_cpu(double elapsed)
+{
+	return elapsed > 0 ? cpu_seconds() / elapsed : 0;
+}
+
+void
+loop_stats_report(FILE *f, double elapsed)
+{
+	const struct histogram *lag = &loop_stats.send_lag;
+	const struct loop_stats *l = &loop_stats;
+
+	fprintf(f, "Client: %.0f%% CPU, loop busy mean %.0fus max %.1fms, %.1f events per wakeup",
+		100 * loop_stats_cpu(elapsed), l->iterations ? 1e6 * l->busy / l->iterations : 0,
+		1e3 * l->max_busy, l->iterations ? (double)l->events / l->iterations : 0);
+	if (lag->count) {
+		fprintf(f, ", send lag p50 %.2fms p99 %.2fms max %.2fms",
+			1e3 * histogram_percentile(lag, 50), 1e3 * histogram_percentile(lag, 99),
+			1e3 * lag->max);
+	}
+	fprintf(f, "\n");
+	if (l->saturated_intervals) {
+		fprintf(f, "WARNING: the client was saturated for %u of %u seconds, the latencies "
+			"include time spent waiting for cxbench\n", l->saturated_intervals, l->intervals);
+	}
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef LOOP_STATS_H
+#define LOOP_STATS_H
+
+/* How well cxbench itself keeps up: how late queries go out compared to the
+ * schedule, how long the event loop is busy each time it wakes up, and how
+ * much CPU it uses. If the client is saturated, the latencies it measures
+ * include its own delays. */
+
+#include <stdio.h>
+
+#include "histogram.h"
+
+struct loop_stats {
+	struct histogram send_lag; /* Time between when a query was due and sent */
+	unsigned long iterations;
+	double busy; /* Seconds spent between wakeups and going back to sleep */
+	double max_busy;
+	unsigned long events;
+	unsigned int intervals;
+	unsigned int saturated_intervals;
+};
+
+extern struct loop_stats loop_stats;
+
+void loop_stats_wakeup(int events); /* Called by the pollers */
+void loop_stats_idle(void); /* Just before waiting */
+void loop_stats_send(double lag);
+void loop_stats_limited(void); /* A query was due, but -p queries were in flight */
+
+/* Once a second: finish the interval, append a summary of it to the
+   progress line, and warn if the client was the bottleneck. */
+void loop_stats_interval(char *progress, size_t len, unsigned int parallel);
+double loop_stats_cpu(double elapsed); /* Fraction of a CPU used so far */
+void loop_stats_report(FILE *, double elapsed);
+
+#endif /* !LOOP_STATS_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
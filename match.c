@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <regex.h>
+
+#include "match.h"
+#include "debug.h"
+
+enum { ALPHABET = 256 };
+
+struct match_rule {
+	char *description;
+	enum match_kind kind;
+	int is_regex;
+	regex_t re;
+	const char *pattern;
+};
+
+struct matcher {
+	struct match_rule *rules;
+	unsigned int num_rules;
+	unsigned int num_expect_substrings;
+
+	/* The Aho-Corasick automaton as a complete DFA: delta[state * ALPHABET + c] */
+	int32_t *delta;
+	unsigned int num_states;
+	/* Rules matched when entering a state: out[out_start[s] .. out_end[s]) */
+	unsigned int *out_start;
+	unsigned int *out_end;
+	unsigned int *out;
+};
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+struct matcher *
+matcher_new(void)
+{
+	struct matcher *m = xrealloc(NULL, sizeof *m);
+	memset(m, 0, sizeof *m);
+	return m;
+}
+
+void
+matcher_add(struct matcher *m, const char *pattern, enum match_kind kind, int is_regex)
+{
+	m->rules = xrealloc(m->rules, (m->num_rules + 1) * sizeof m->rules[0]);
+	struct match_rule *rule = &m->rules[m->num_rules];
+	memset(rule, 0, sizeof *rule);
+	rule->kind = kind;
+	rule->is_regex = is_regex;
+	rule->pattern = pattern;
+
+	size_t desc_len = strlen(pattern) + 30;
+	rule->description = xrealloc(NULL, desc_len);
+	snprintf(rule->description, desc_len, "%s%s '%s'",
+		 kind == MATCH_EXPECT ? "expect" : "reject", is_regex ? "-regex" : "", pattern);
+
+	if (is_regex) {
+		int error = regcomp(&rule->re, pattern, REG_EXTENDED | REG_NOSUB);
+		if (error) {
+			char msg[200];
+			regerror(error, &rule->re, msg, sizeof msg);
+			fprintf(stderr, "Invalid regex '%s': %s\n", pattern, msg);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		if (!*pattern) {
+			fprintf(stderr, "Empty match pattern\n");
+			exit(EXIT_FAILURE);
+		}
+		if (kind == MATCH_EXPECT)
+			m->num_expect_substrings++;
+	}
+	m->num_rules++;
+}
+
+unsigned int
+matcher_num_rules(const struct matcher *m)
+{
+	return m->num_rules;
+}
+
+void
+matcher_compile(struct matcher *m)
+{
+	unsigned int r, s, c;
+	size_t max_states = 1;
+
+	for (r = 0; r < m->num_rules; r++) {
+		if (!m->rules[r].is_regex)
+			max_states += strlen(m->rules[r].pattern);
+	}
+
+	/* Build the trie. 0 is the root, and no trie edge ever leads back to
+	   the root, so 0 doubles as "no edge" until the failure links are in. */
+	m->delta = xrealloc(NULL, max_states * ALPHABET * sizeof m->delta[0]);
+	memset(m->delta, 0, max_states * ALPHABET * sizeof m->delta[0]);
+	int32_t *own_rule = xrealloc(NULL, max_states * sizeof own_rule[0]);
+	int32_t *chain = xrealloc(NULL, m->num_rules * sizeof chain[0]);
+	m->num_states = 1;
+	own_rule[0] = -1;
+
+	for (r = 0; r < m->num_rules; r++) {
+		const unsigned char *p = (const unsigned char *)m->rules[r].pattern;
+		if (m->rules[r].is_regex)
+			continue;
+		s = 0;
+		for (; *p; p++) {
+			int32_t *edge = &m->delta[s * ALPHABET + *p];
+			if (!*edge) {
+				own_rule[m->num_states] = -1;
+				*edge = m->num_states++;
+			}
+			s = *edge;
+		}
+		/* Several rules may end in the same state, chain them */
+		chain[r] = own_rule[s];
+		own_rule[s] = r;
+	}
+
+	/* Breadth first to fill in the failure transitions, and collect the
+	   output set of each state as its own rules plus those of its failure
+	   state. The failure state is always shallower, so it is done already. */
+	unsigned int *queue = xrealloc(NULL, m->num_states * sizeof queue[0]);
+	unsigned int *fail = xrealloc(NULL, m->num_states * sizeof fail[0]);
+	unsigned int head = 0, tail = 0;
+	size_t out_alloc = 16, num_out = 0;
+	m->out = xrealloc(NULL, out_alloc * sizeof m->out[0]);
+	m->out_start = xrealloc(NULL, m->num_states * sizeof m->out_start[0]);
+	m->out_end = xrealloc(NULL, m->num_states * sizeof m->out_end[0]);
+
+	queue[tail++] = 0;
+	fail[0] = 0;
+	while (head < tail) {
+		s = queue[head++];
+		int32_t ri;
+
+		m->out_start[s] = num_out;
+		for (ri = own_rule[s]; ri != -1; ri = chain[ri]) {
+			if (num_out == out_alloc) {
+				out_alloc *= 2;
+				m->out = xrealloc(m->out, out_alloc * sizeof m->out[0]);
+			}
+			m->out[num_out++] = ri;
+		}
+		if (s) {
+			unsigned int f = fail[s], o;
+			for (o = m->out_start[f]; o < m->out_end[f]; o++) {
+				if (num_out == out_alloc) {
+					out_alloc *= 2;
+					m->out = xrealloc(m->out, out_alloc * sizeof m->out[0]);
+				}
+				m->out[num_out++] = m->out[o];
+			}
+		}
+		m->out_end[s] = num_out;
+
+		for (c = 0; c < ALPHABET; c++) {
+			int32_t *edge = &m->delta[s * ALPHABET + c];
+			if (*edge) {
+				fail[*edge] = s ? (unsigned int)m->delta[fail[s] * ALPHABET + c] : 0;
+				queue[tail++] = *edge;
+			} else {
+				*edge = s ? m->delta[fail[s] * ALPHABET + c] : 0;
+			}
+		}
+	}
+
+	debug("match automaton: %u rules, %u states, %zu outputs\n",
+	      m->num_rules, m->num_states, num_out);
+
+	free(fail);
+	free(queue);
+	free(chain);
+	free(own_rule);
+}
+
+const char *
+matcher_check(const struct matcher *m, const char *buf, size_t len)
+{
+	unsigned int r;
+
+	if (m->num_states > 1) {
+		const unsigned char *p = (const unsigned char *)buf;
+		const unsigned char *end = p + len;
+		unsigned char *seen = alloca(m->num_rules);
+		unsigned int expect_left = m->num_expect_substrings;
+		int32_t s = 0;
+
+		memset(seen, 0, m->num_rules);
+		for (; p < end; p++) {
+			s = m->delta[s * ALPHABET + *p];
+			unsigned int o;
+			for (o = m->out_start[s]; o < m->out_end[s]; o++) {
+				const struct match_rule *rule = &m->rules[m->out[o]];
+				if (rule->kind == MATCH_REJECT)
+					return rule->description;
+				if (!seen[m->out[o]]) {
+					seen[m->out[o]] = 1;
+					expect_left--;
+				}
+			}
+		}
+		if (expect_left) {
+			for (r = 0; r < m->num_rules; r++) {
+				const struct match_rule *rule = &m->rules[r];
+				if (!rule->is_regex && rule->kind == MATCH_EXPECT && !seen[r])
+					return rule->description;
+			}
+		}
+	}
+
+	for (r = 0; r < m->num_rules; r++) {
+		const struct match_rule *rule = &m->rules[r];
+		if (!rule->is_regex)
+			continue;
+#ifdef REG_STARTEND
+		/* The whole body, past any NUL in it */
+		regmatch_t range = { .rm_so = 0, .rm_eo = len };
+		int matched = regexec(&rule->re, buf, 1, &range, REG_STARTEND) == 0;
+#else
+		int matched = regexec(&rule->re, buf, 0, NULL, 0) == 0;
+#endif
+		if (matched != (rule->kind == MATCH_EXPECT))
+			return rule->description;
+	}
+	return NULL;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef MATCH_H
+#define MATCH_H
+
+/* Response validation rules. All the substring rules are compiled into a
+ * single Aho-Corasick automaton so a response body is checked against all
+ * of them in one pass. Regex rules are checked one by one afterwards. */
+
+#include <sys/types.h>
+
+enum match_kind {
+	MATCH_EXPECT, /* Must be present */
+	MATCH_REJECT  /* Must not be present */
+};
+
+struct matcher;
+
+struct matcher *matcher_new(void);
+void matcher_add(struct matcher *, const char *pattern, enum match_kind kind, int is_regex);
+void matcher_compile(struct matcher *);
+unsigned int matcher_num_rules(const struct matcher *);
+
+/* Check buf[0..len). Where regexec() has no REG_STARTEND the regex rules
+   need buf NUL terminated, and stop at the first NUL. Returns NULL if all
+   rules pass, otherwise a description of the first failing rule. */
+const char *matcher_check(const struct matcher *, const char *buf, size_t len);
+
+#endif /* !MATCH_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "metrics.h"
+#include "debug.h"
+#include "dynbuf.h"
+#include "expdecay.h"
+#include "connection-info.h"
+#include "wait-interface.h"
+#include "stats.h"
+#include "target.h"
+#include "histogram.h"
+
+enum {
+	MAX_CLIENTS = MAX_SERVICE_FDS - 1, /* One is the listener */
+	MAX_REQUEST = 8192,
+	SEND_BUFFER = 1 << 20,
+};
+
+/* Bucket bounds for the latency histogram, in seconds */
+static const double latency_bounds[] = {
+	0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+};
+
+static struct conn_info listener;
+static struct conn_info clients[MAX_CLIENTS];
+
+static int handle_accept(struct expdecay *, struct conn_info *);
+static int handle_scrape(struct expdecay *, struct conn_info *);
+
+void
+metrics_start(const char *address, unsigned int port)
+{
+	struct sockaddr_in sin;
+	const int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd == -1) {
+		fprintf(stderr, "metrics: socket() fails: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fd = fd_above_connections(fd);
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+	memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(port);
+	if (address && inet_pton(AF_INET, address, &sin.sin_addr) != 1) {
+		fprintf(stderr, "metrics: invalid IPv4 address '%s'\n", address);
+		exit(EXIT_FAILURE);
+	}
+	if (bind(fd, (struct sockaddr *)&sin, sizeof sin) == -1 || listen(fd, 16) == -1) {
+		fprintf(stderr, "metrics: cannot listen on %s:%u: %s\n",
+			inet_ntoa(sin.sin_addr), port, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+	listener.fd = fd;
+	listener.handler = handle_accept;
+	listener.status = CONN_CONNECTED;
+	wait_for_service(&listener);
+	fprintf(stderr, "Serving metrics on %s:%u\n", inet_ntoa(sin.sin_addr), port);
+}
+
+static int
+handle_accept(struct expdecay *query_stats, struct conn_info *l)
+{
+	(void)query_stats;
+	for (;;) {
+		int fd = accept(l->fd, NULL, NULL);
+		if (fd == -1) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+				debug("metrics: accept fails: %s\n", strerror(errno));
+			return 1;
+		}
+
+		struct conn_info *c = NULL;
+		unsigned int n;
+		for (n = 0; n < MAX_CLIENTS && !c; n++) {
+			if (clients[n].status == CONN_UNUSED)
+				c = &clients[n];
+		}
+		if (!c) {
+			debug("metrics: too many clients, dropping one\n");
+			close(fd);
+			continue;
+		}
+		fd = fd_above_connections(fd);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		c->fd = fd;
+		c->handler = handle_scrape;
+		c->status = CONN_WAITING_RESULT;
+		dynbuf_init(&c->data);
+		wait_for_service(c);
+	}
+}
+
+static void
+close_client(struct conn_info *c)
+{
+	unregister_service(c);
+	close(c->fd);
+	dynbuf_free(&c->data);
+	c->status = CONN_UNUSED;
+}
+
+static void
+put_metric(struct dynbuf *d, const char *name, const char *type, const char *help)
+{
+	dynbuf_printf(d, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void
+put_histogram(struct dynbuf *d, const char *name, const char *labels, const struct histogram *h)
+{
+	unsigned int n;
+	const char *sep = *labels ? "," : "";
+
+	for (n = 0; n < sizeof latency_bounds / sizeof latency_bounds[0]; n++) {
+		dynbuf_printf(d, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels, sep,
+			      latency_bounds[n],
+			      (unsigned long long)histogram_count_below(h, latency_bounds[n]));
+	}
+	dynbuf_printf(d, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels, sep,
+		      (unsigned long long)h->count);
+	if (*labels) {
+		dynbuf_printf(d, "%s_sum{%s} %.6f\n", name, labels, h->sum);
+		dynbuf_printf(d, "%s_count{%s} %llu\n", name, labels, (unsigned long long)h->count);
+	} else {
+		dynbuf_printf(d, "%s_sum %.6f\n", name, h->sum);
+		dynbuf_printf(d, "%s_count %llu\n", name, (unsigned long long)h->count);
+	}
+}
+
+static void
+build_metrics(struct dynbuf *d, struct expdecay *query_stats)
+{
+	unsigned long sent = 0, completed = 0, in_flight = 0;
+	unsigned int n;
+	int rc;
+
+	/* The latency histogram is kept per target, add them up */
+	static struct histogram latency;
+	histogram_init(&latency);
+	for (n = 0; n < num_targets; n++) {
+		sent += targets[n].sent;
+		completed += targets[n].completed;
+		in_flight += targets[n].outstanding;
+		histogram_merge(&latency, &targets[n].latency);
+	}
+
+	put_metric(d, "cxbench_queries_sent_total", "counter", "Queries sent");
+	dynbuf_printf(d, "cxbench_queries_sent_total %lu\n", sent);
+	put_metric(d, "cxbench_queries_completed_total", "counter", "Queries with a complete response");
+	dynbuf_printf(d, "cxbench_queries_completed_total %lu\n", completed);
+	put_metric(d, "cxbench_queries_in_flight", "gauge", "Queries waiting for a response");
+	dynbuf_printf(d, "cxbench_queries_in_flight %lu\n", in_flight);
+	put_metric(d, "cxbench_query_rate", "gauge", "Completed queries per second, decaying average");
+	dynbuf_printf(d, "cxbench_query_rate %.3f\n", expdecay_value(query_stats));
+
+	put_metric(d, "cxbench_results_total", "counter", "Finished queries by result class");
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++) {
+		dynbuf_printf(d, "cxbench_results_total{class=\"%s\"} %lu\n",
+			      result_class_name(rc), run_stats.results[rc]);
+	}
+	put_metric(d, "cxbench_responses_total", "counter", "Responses by HTTP status");
+	for (rc = 0; rc < 600; rc++) {
+		if (run_stats.status_codes[rc])
+			dynbuf_printf(d, "cxbench_responses_total{code=\"%d\"} %lu\n", rc,
+				      run_stats.status_codes[rc]);
+	}
+	put_metric(d, "cxbench_response_bytes_total", "counter", "Response bytes received");
+	dynbuf_printf(d, "cxbench_response_bytes_total %llu\n", run_stats.response_bytes);
+
+	put_metric(d, "cxbench_latency_seconds", "histogram", "Time from connect to complete response");
+	put_histogram(d, "cxbench_latency_seconds", "", &latency);
+
+	if (num_targets > 1) {
+		put_metric(d, "cxbench_target_queries_sent_total", "counter", "Queries sent per target");
+		for (n = 0; n < num_targets; n++)
+			dynbuf_printf(d, "cxbench_target_queries_sent_total{target=\"%s\"} %lu\n",
+				      targets[n].name, targets[n].sent);
+		put_metric(d, "cxbench_target_errors_total", "counter", "Failed queries per target");
+		for (n = 0; n < num_targets; n++)
+			dynbuf_printf(d, "cxbench_target_errors_total{target=\"%s\"} %lu\n",
+				      targets[n].name, targets[n].errors);
+		put_metric(d, "cxbench_target_latency_seconds", "histogram", "Latency per target");
+		for (n = 0; n < num_targets; n++) {
+			char labels[sizeof targets[n].name + 16];
+			snprintf(labels, sizeof labels, "target=\"%s\"", targets[n].name);
+			put_histogram(d, "cxbench_target_latency_seconds", labels, &targets[n].latency);
+		}
+	}
+}
+
+static int
+handle_scrape(struct expdecay *query_stats, struct conn_info *c)
+{
+	ssize_t len;
+
+	dynbuf_ensure_space(&c->data, MAX_REQUEST + 1);
+	len = read(c->fd, c->data.buffer + c->data.pos, MAX_REQUEST - c->data.pos);
+	if (len == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+		return 1;
+	if (len <= 0) {
+		close_client(c);
+		return 0;
+	}
+	c->data.pos += len;
+	c->data.buffer[c->data.pos] = 0;
+	if (!strstr(c->data.buffer, "\r\n\r\n") && !strstr(c->data.buffer, "\n\n")) {
+		if (c->data.pos < MAX_REQUEST)
+			return 1; /* Wait for the rest of the request */
+	}
+
+	struct dynbuf body, response;
+	dynbuf_init(&body);
+	dynbuf_init(&response);
+	if (strncmp(c->data.buffer, "GET /metrics ", 13) == 0) {
+		build_metrics(&body, query_stats);
+		dynbuf_printf(&response, "HTTP/1.0 200 OK\r\n"
+			      "Content-Type: text/plain; version=0.0.4\r\n");
+	} else {
+		dynbuf_printf(&body, "Try /metrics\n");
+		dynbuf_printf(&response, "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\n");
+	}
+	dynbuf_printf(&response, "Content-Length: %zu\r\nConnection: close\r\n\r\n", body.pos);
+	dynbuf_ensure_space(&response, body.pos);
+	memcpy(response.buffer + response.pos, body.buffer, body.pos);
+	response.pos += body.pos;
+
+	/* A big send buffer lets the whole response go in one write, so the
+	   event loop never has to wait for a slow scraper */
+	const int sndbuf = SEND_BUFFER;
+	setsockopt(c->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof sndbuf);
+	len = write(c->fd, response.buffer, response.pos);
+	if (len != (ssize_t)response.pos)
+		debug("metrics: short write %zd/%zu, dropping the rest\n", len, response.pos);
+
+	dynbuf_free(&body);
+	dynbuf_free(&response);
+	close_client(c);
+	return 0;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
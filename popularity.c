@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "popularity.h"
+#include "rng.h"
+
+enum popularity_mode { POPULARITY_ZIPF, POPULARITY_HOTSET };
+
+static enum popularity_mode mode;
+static double zipf_s;
+static double hot_fraction, hot_probability;
+
+static size_t n;
+static size_t hot; /* Size of the hot set */
+
+/* The alias table: pick slot i uniformly, then keep i if the low 32 bits
+   of the same random number are below threshold[i], else take alias[i]. */
+static uint32_t *threshold;
+static uint32_t *alias;
+
+void
+popularity_parse(const char *arg)
+{
+	char *end;
+
+	if (!strncmp(arg, "zipf:", 5)) {
+		mode = POPULARITY_ZIPF;
+		zipf_s = strtod(arg + 5, &end);
+		if (end == arg + 5 || *end || !(zipf_s > 0))
+			goto invalid;
+		return;
+	}
+	if (!strncmp(arg, "hotset:", 7)) {
+		mode = POPULARITY_HOTSET;
+		hot_fraction = strtod(arg + 7, &end);
+		if (end == arg + 7 || *end != ':' || !(hot_fraction > 0 && hot_fraction < 1))
+			goto invalid;
+		const char *p = end + 1;
+		hot_probability = strtod(p, &end);
+		if (end == p || *end || !(hot_probability >= 0 && hot_probability <= 1))
+			goto invalid;
+		return;
+	}
+
+invalid:
+	fprintf(stderr, "Invalid distribution '%s', give zipf:<s> with s > 0 or "
+		"hotset:<fraction>:<probability> with both between 0 and 1\n", arg);
+	exit(EXIT_FAILURE);
+}
+
+static void *
+xmalloc(size_t size)
+{
+	void *p = malloc(size);
+	if (!p) {
+		fprintf(stderr, "malloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+/* Vose's alias method. Each slot holds 1/n of the probability mass, split
+   between its own rank and one other. */
+static void
+build_zipf(void)
+{
+	double *p = xmalloc(n * sizeof p[0]);
+	uint32_t *small = xmalloc(n * sizeof small[0]);
+	uint32_t *large = xmalloc(n * sizeof large[0]);
+	size_t num_small = 0, num_large = 0, k;
+	double sum = 0;
+
+	for (k = 0; k < n; k++) {
+		p[k] = pow(k + 1, -zipf_s);
+		sum += p[k];
+	}
+	for (k = 0; k < n; k++) {
+		p[k] *= n / sum;
+		if (p[k] < 1)
+			small[num_small++] = k;
+		else
+			large[num_large++] = k;
+	}
+	threshold = xmalloc(n * sizeof threshold[0]);
+	alias = xmalloc(n * sizeof alias[0]);
+	while (num_small && num_large) {
+		uint32_t s = small[--num_small], l = large[num_large - 1];
+		threshold[s] = p[s] * 4294967296.0;
+		alias[s] = l;
+		p[l] -= 1 - p[s];
+		if (p[l] < 1) {
+			num_large--;
+			small[num_small++] = l;
+		}
+	}
+	/* What is left is 1 up to rounding */
+	while (num_large) {
+		k = large[--num_large];
+		threshold[k] = UINT32_MAX;
+		alias[k] = k;
+	}
+	while (num_small) {
+		k = small[--num_small];
+		threshold[k] = UINT32_MAX;
+		alias[k] = k;
+	}
+	free(large);
+	free(small);
+	free(p);
+}
+
+void
+popularity_init(size_t num_queries)
+{
+	n = num_queries;
+	if (mode == POPULARITY_ZIPF) {
+		if (n > UINT32_MAX) {
+			fprintf(stderr, "Too many queries for a Zipf distribution\n");
+			exit(EXIT_FAILURE);
+		}
+		build_zipf();
+	} else {
+		hot = ceil(hot_fraction * n);
+		if (hot < 1)
+			hot = 1;
+		if (hot >= n)
+			hot_probability = 1;
+	}
+}
+
+size_t
+popularity_sample(struct rng *r)
+{
+	if (mode == POPULARITY_ZIPF) {
+		uint64_t x = rng_next(r);
+		size_t k = ((x >> 32) * n) >> 32;
+		return (uint32_t)x < threshold[k] ? k : alias[k];
+	}
+	if (rng_double(r) < hot_probability)
+		return rng_below(r, hot);
+	return hot + rng_below(r, n - hot);
+}
+
+void
+popularity_report(FILE *f)
+{
+	if (mode == POPULARITY_HOTSET) {
+		fprintf(f, " - hot set of %zu queries getting %.1f%% of the requests\n",
+			hot, 100 * hot_probability);
+		return;
+	}
+	/* The share of the top 1% and of the most popular query */
+	size_t top = n / 100 ? n / 100 : 1, k;
+	double sum = 0, top_sum = 0;
+	for (k = 0; k < n; k++) {
+		double w = pow(k + 1, -zipf_s);
+		sum += w;
+		if (k < top)
+			top_sum += w;
+	}
+	fprintf(f, " - Zipf s=%g: the top %zu queries get %.1f%% of the requests, "
+		"the first one %.2f%%\n", zipf_s, top, 100 * top_sum / sum, 100 / sum);
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,42 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef POPULARITY_H
+#define POPULARITY_H
+
+/* Skewed query popularity. Real keys are not equally popular, and the skew
+ * decides the cache hit rates, so instead of picking queries uniformly we
+ * can pick the one at rank k in the query list (after -r, if given) from a
+ * Zipf or a hot-set distribution. Zipf uses an alias table, built once, so
+ * every pick is O(1) with a single random number. */
+
+#include <stdio.h>
+#include <stddef.h>
+
+struct rng;
+
+void popularity_parse(const char *arg); /* zipf:<s> or hotset:<fraction>:<probability> */
+void popularity_init(size_t num_queries);
+size_t popularity_sample(struct rng *); /* Index into the query list */
+void popularity_report(FILE *);
+
+#endif /* !POPULARITY_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
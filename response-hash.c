@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "response-hash.h"
+#include "connection-info.h"
+#include "xxh64.h"
+
+enum { MAX_LISTED = 10 }; /* Queries listed in the report */
+
+struct golden {
+	char *query;
+	uint64_t hash;
+	int status;
+	int varies; /* Different responses while recording, not checked */
+	unsigned long mismatches;
+};
+
+int hashing_responses;
+
+static int recording;
+static const char *record_filename;
+static FILE *record_file;
+
+/* Open addressing on the query text, at most half full */
+static struct golden **table;
+static size_t table_size, num_entries;
+
+static unsigned long matched, mismatched, unknown, varied;
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static uint32_t
+hash_query(const char *query)
+{
+	uint32_t h = 2166136261u; /* FNV-1a */
+
+	for (; *query; query++)
+		h = (h ^ (unsigned char)*query) * 16777619u;
+	return h;
+}
+
+static struct golden **
+find_slot(struct golden **t, size_t size, const char *query)
+{
+	size_t n;
+
+	for (n = hash_query(query) % size; t[n]; n = (n + 1) % size) {
+		if (!strcmp(t[n]->query, query))
+			break;
+	}
+	return &t[n];
+}
+
+static void
+grow_table(void)
+{
+	size_t new_size = table_size ? 2 * table_size : 1024, n;
+	struct golden **t = xrealloc(NULL, new_size * sizeof t[0]);
+
+	memset(t, 0, new_size * sizeof t[0]);
+	for (n = 0; n < table_size; n++) {
+		if (table[n])
+			*find_slot(t, new_size, table[n]->query) = table[n];
+	}
+	free(table);
+	table = t;
+	table_size = new_size;
+}
+
+static struct golden *
+add_entry(const char *query, size_t len)
+{
+	if (2 * (num_entries + 1) > table_size)
+		grow_table();
+	struct golden *g = xrealloc(NULL, sizeof *g);
+	memset(g, 0, sizeof *g);
+	g->query = xrealloc(NULL, len + 1);
+	memcpy(g->query, query, len);
+	g->query[len] = 0;
+	struct golden **slot = find_slot(table, table_size, g->query);
+	if (*slot) {
+		fprintf(stderr, "Query '%s' is in the hash file twice\n", g->query);
+		exit(EXIT_FAILURE);
+	}
+	*slot = g;
+	num_entries++;
+	return g;
+}
+
+void
+response_hash_record(const char *filename)
+{
+	/* Open it now, rather than finding out after the run that we cannot */
+	record_file = fopen_above_connections(filename, "w");
+	if (!record_file) {
+		fprintf(stderr, "Cannot open hash file '%s' for writing: %s\n", filename,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	record_filename = filename;
+	recording = 1;
+	hashing_responses = 1;
+	grow_table();
+}
+
+/* Lines of <status> <hash> <query>, or - - <query> for a query that gave
+   different responses while recording */
+void
+response_hash_verify(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	char *line = NULL;
+	size_t alloc = 0;
+	ssize_t len;
+	unsigned long line_no = 0;
+
+	if (!f) {
+		fprintf(stderr, "Cannot open hash file '%s': %s\n", filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	grow_table();
+	while ((len = getline(&line, &alloc, f)) != -1) {
+		char *p = line, *end;
+		struct golden *g;
+		int status;
+		uint64_t hash;
+
+		line_no++;
+		if (len && line[len - 1] == '\n')
+			line[--len] = 0;
+		if (!strncmp(p, "- - ", 4)) {
+			g = add_entry(p + 4, len - 4);
+			g->varies = 1;
+			continue;
+		}
+		status = strtol(p, &end, 10);
+		if (end == p || *end != ' ')
+			goto invalid;
+		p = end + 1;
+		hash = strtoull(p, &end, 16);
+		if (end - p != 16 || *end != ' ')
+			goto invalid;
+		p = end + 1;
+		g = add_entry(p, len - (p - line));
+		g->status = status;
+		g->hash = hash;
+	}
+	free(line);
+	fclose(f);
+	hashing_responses = 1;
+	fprintf(stderr, "Read response hashes for %zu queries from '%s'\n", num_entries, filename);
+	return;
+
+invalid:
+	fprintf(stderr, "%s:%lu: not <status> <16 hex digit hash> <query>\n", filename, line_no);
+	exit(EXIT_FAILURE);
+}
+
+void
+response_hash_start(struct conn_info *conn)
+{
+	xxh64_init(&conn->body_hash, 0);
+	conn->hashed = 0;
+}
+
+void
+response_hash_update(struct conn_info *conn, size_t body_start, size_t body_end)
+{
+	if (conn->hashed < body_start)
+		conn->hashed = body_start;
+	if (body_end > conn->hashed) {
+		xxh64_update(&conn->body_hash, conn->data.buffer + conn->hashed,
+			     body_end - conn->hashed);
+		conn->hashed = body_end;
+	}
+}
+
+enum hash_result
+response_hash_done(struct conn_info *conn, const char *query, int status,
+		   uint64_t *hash, uint64_t *expected)
+{
+	struct golden **slot;
+	struct golden *g;
+
+	*hash = xxh64_digest(&conn->body_hash);
+	if (recording) {
+		if (2 * (num_entries + 1) > table_size)
+			grow_table();
+		slot = find_slot(table, table_size, query);
+		if (!*slot) {
+			g = add_entry(query, strlen(query));
+			g->status = status;
+			g->hash = *hash;
+			return HASH_RECORDED;
+		}
+		g = *slot;
+		*expected = g->hash;
+		if (!g->varies && (g->status != status || g->hash != *hash)) {
+			g->varies = 1;
+			varied++;
+		}
+		return g->varies ? HASH_VARIES : HASH_RECORDED;
+	}
+
+	g = *find_slot(table, table_size, query);
+	if (!g) {
+		unknown++;
+		return HASH_UNKNOWN;
+	}
+	if (g->varies) {
+		varied++;
+		return HASH_VARIES;
+	}
+	*expected = g->hash;
+	if (g->status == status && g->hash == *hash) {
+		matched++;
+		return HASH_MATCH;
+	}
+	g->mismatches++;
+	mismatched++;
+	return HASH_MISMATCH;
+}
+
+void
+response_hash_finish(void)
+{
+	size_t n;
+
+	if (!recording)
+		return;
+	for (n = 0; n < table_size; n++) {
+		const struct golden *g = table[n];
+		if (!g)
+			continue;
+		if (g->varies)
+			fprintf(record_file, "- - %s\n", g->query);
+		else
+			fprintf(record_file, "%d %016llx %s\n", g->status,
+				(unsigned long long)g->hash, g->query);
+	}
+	if (fclose(record_file)) {
+		fprintf(stderr, "Error writing hash file '%s': %s\n", record_filename,
+			strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	record_file = NULL;
+}
+
+static int
+by_mismatches(const void *a, const void *b)
+{
+	const struct golden *ga = *(const struct golden * const *)a;
+	const struct golden *gb = *(const struct golden * const *)b;
+	return (ga->mismatches < gb->mismatches) - (ga->mismatches > gb->mismatches);
+}
+
+void
+response_hash_report(FILE *f)
+{
+	size_t n, num_listed = 0;
+	struct golden **listed;
+
+	if (recording) {
+		fprintf(f, "Response hashes: %zu queries recorded to '%s', %lu of them gave "
+			"differing responses and will not be checked\n", num_entries,
+			record_filename, varied);
+		return;
+	}
+	fprintf(f, "Response hashes: %lu match, %lu mismatch, %lu not recorded, "
+		"%lu not checked as they varied\n", matched, mismatched, unknown, varied);
+	if (!mismatched)
+		return;
+
+	listed = xrealloc(NULL, num_entries * sizeof listed[0]);
+	for (n = 0; n < table_size; n++) {
+		if (table[n] && table[n]->mismatches)
+			listed[num_listed++] = table[n];
+	}
+	qsort(listed, num_listed, sizeof listed[0], by_mismatches);
+	fprintf(f, "  Mismatches in %zu queries%s\n", num_listed,
+		num_listed > MAX_LISTED ? ", the worst ones:" : ":");
+	for (n = 0; n < num_listed && n < MAX_LISTED; n++)
+		fprintf(f, "  %8lu %s\n", listed[n]->mismatches, listed[n]->query);
+	free(listed);
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
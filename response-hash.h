@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef RESPONSE_HASH_H
+#define RESPONSE_HASH_H
+
+/* Golden response checking. --record-hashes keeps the status and an XXH64
+ * of the body of each query's response and writes them to a file at the
+ * end. --verify-hashes loads such a file and counts the responses that
+ * differ, per query, while the benchmark runs. The body is hashed as it
+ * arrives, so large responses are not gone over a second time. */
+
+#include <stdio.h>
+#include <stdint.h>
+
+struct conn_info;
+
+enum hash_result { HASH_RECORDED, HASH_MATCH, HASH_MISMATCH, HASH_UNKNOWN, HASH_VARIES };
+
+extern int hashing_responses;
+
+void response_hash_record(const char *filename);
+void response_hash_verify(const char *filename);
+void response_hash_start(struct conn_info *);
+/* Hash what has arrived of the body, conn->data[body_start..body_end) */
+void response_hash_update(struct conn_info *, size_t body_start, size_t body_end);
+/* The response is complete. *hash is its hash, *expected the recorded one */
+enum hash_result response_hash_done(struct conn_info *, const char *query, int status,
+				    uint64_t *hash, uint64_t *expected);
+void response_hash_finish(void); /* Writes the file when recording */
+void response_hash_report(FILE *);
+
+#endif /* !RESPONSE_HASH_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/types.h>
+#include <unistd.h>
+#include <string.h>
+#include <math.h>
+
+#include "rng.h"
+#include "timeutil.h"
+
+static inline uint64_t
+rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t
+splitmix64(uint64_t *x)
+{
+	uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+void
+rng_init(struct rng *r, uint64_t seed)
+{
+	/* xoshiro must not be seeded with all zeroes, splitmix64 takes care of that */
+	int i, l;
+	for (i = 0; i < 4; i++)
+		r->s[i] = splitmix64(&seed);
+	for (l = 0; l < RNG_LANES; l++)
+		for (i = 0; i < 4; i++)
+			r->lane[i][l] = splitmix64(&seed);
+}
+
+uint64_t
+rng_next(struct rng *r)
+{
+	uint64_t *s = r->s;
+	const uint64_t result = rotl(s[1] * 5, 7) * 9;
+	const uint64_t t = s[1] << 17;
+
+	s[2] ^= s[0];
+	s[3] ^= s[1];
+	s[1] ^= s[2];
+	s[0] ^= s[3];
+	s[2] ^= t;
+	s[3] = rotl(s[3], 45);
+
+	return result;
+}
+
+/* Build a double in [1, 2) from the top 52 bits and subtract 1. Unlike a
+   uint64 -> double conversion this is plain integer ops, which vectorize. */
+static inline double
+bits_to_double(uint64_t x)
+{
+	union { uint64_t i; double d; } u;
+	u.i = (x >> 12) | 0x3ff0000000000000ULL;
+	return u.d - 1.0;
+}
+
+double
+rng_double(struct rng *r)
+{
+	return bits_to_double(rng_next(r));
+}
+
+size_t
+rng_below(struct rng *r, size_t n)
+{
+	return (size_t)(rng_double(r) * n);
+}
+
+void
+rng_fill_exponential(struct rng *r, double *out, size_t n)
+{
+	uint64_t (*s)[RNG_LANES] = r->lane;
+	size_t i;
+	int l;
+
+	/* Run RNG_LANES independent xoshiro streams side by side. There are no
+	   dependencies between the lanes, so the compiler can keep them in
+	   vector registers. */
+	for (i = 0; i + RNG_LANES <= n; i += RNG_LANES) {
+		for (l = 0; l < RNG_LANES; l++) {
+			const uint64_t result = rotl(s[1][l] * 5, 7) * 9;
+			const uint64_t t = s[1][l] << 17;
+			s[2][l] ^= s[0][l];
+			s[3][l] ^= s[1][l];
+			s[1][l] ^= s[2][l];
+			s[0][l] ^= s[3][l];
+			s[2][l] ^= t;
+			s[3][l] = rotl(s[3][l], 45);
+			out[i + l] = bits_to_double(result);
+		}
+	}
+	for (; i < n; i++)
+		out[i] = rng_double(r);
+
+	for (i = 0; i < n; i++)
+		out[i] = -log(1.0 - out[i]); /* 1.0 - u guaranteed > 0 */
+}
+
+uint64_t
+rng_default_seed(void)
+{
+	uint64_t seed = (uint64_t)(now() * 1e6);
+	return seed ^ ((uint64_t)getpid() << 32);
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+/* A small, seedable xoshiro256** pseudo random number generator. All the
+ * state lives in the struct, so every user can have its own stream and a
+ * run can be reproduced exactly from the seed. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum { RNG_LANES = 4 }; /* Independent streams used for batch generation */
+
+struct rng {
+	uint64_t s[4];
+	uint64_t lane[4][RNG_LANES]; /* [state word][lane], vectorizer friendly */
+};
+
+void rng_init(struct rng *, uint64_t seed);
+uint64_t rng_next(struct rng *);
+double rng_double(struct rng *); /* Uniform in [0, 1) */
+size_t rng_below(struct rng *, size_t n); /* Uniform in [0, n) */
+
+/* Fill out[0..n) with exponentially distributed values with mean 1 */
+void rng_fill_exponential(struct rng *, double *out, size_t n);
+
+uint64_t rng_default_seed(void);
+
+#endif /* !RNG_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
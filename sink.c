@@ -0,0 +1,584 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+/* cxbench-sink: a minimal HTTP/1.x server to point cxbench at, to find out
+   how fast the client itself can go. It answers every request with the same
+   response, optionally after a delay, from one epoll loop per worker. */
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "timeutil.h"
+
+enum {
+	MAX_REQUEST = 16384, /* Request headers and what is read ahead */
+	MAX_EVENTS = 256,
+};
+
+enum connection_mode {
+	CONNECTION_AS_ASKED, /* Close if the client asks, or it is HTTP/1.0 */
+	CONNECTION_CLOSE,
+	CONNECTION_KEEP_ALIVE,
+};
+
+struct sink_conn {
+	unsigned int generation; /* Tells a reused fd from the one a delay was for */
+	int open;
+	uint32_t events; /* Registered with epoll */
+	char *in;
+	size_t in_len;
+	size_t body_left; /* Of the current request, still to be read */
+	int responding; /* From when the request is complete until the response is out */
+	int close_after;
+	size_t out_pos;
+};
+
+/* Delayed responses, in the order they are due. The delay is the same for
+   all, so a ring buffer will do. */
+struct delayed {
+	int fd;
+	unsigned int generation;
+	double due;
+};
+
+static unsigned int port = 8080;
+static size_t body_size = 0;
+static double delay = 0;
+static unsigned int num_workers = 1;
+static enum connection_mode connection_mode = CONNECTION_AS_ASKED;
+
+static char *body;
+static char header_close[200], header_keep_alive[200];
+static size_t header_close_len, header_keep_alive_len;
+
+static int epoll_fd;
+static struct sink_conn *conns;
+static int num_conns;
+static struct delayed *delayed;
+static size_t delayed_head, delayed_count, delayed_alloc;
+static unsigned long requests;
+static volatile sig_atomic_t stop_now;
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	p = realloc(p, size);
+	if (!p) {
+		fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void
+usage(const char *name)
+{
+	fprintf(stderr, "Usage: %s [OPTIONS]\n\n"
+		" -p --port <port> : Listen on <port> [8080]\n"
+		" -s --size <bytes> : Size of the response body [0]\n"
+		" -d --delay <ms> : Wait <ms> before each response [0]\n"
+		" -w --workers <n> : Run <n> processes, each with its own listening socket\n"
+		"    (SO_REUSEPORT) and epoll loop [1]\n"
+		"    --close : Close the connection after every response\n"
+		"    --keep-alive : Never close the connection, whatever the client asks\n\n"
+		"By default connections are kept open unless the client sends Connection: close\n"
+		"or speaks HTTP/1.0 without keep-alive.\n\n", name);
+}
+
+static void
+parse_arguments(int argc, char **argv)
+{
+	enum { OPT_CLOSE = 256, OPT_KEEP_ALIVE };
+	static struct option opts[] = {
+		{ "help", no_argument, NULL, 'h' },
+		{ "port", required_argument, NULL, 'p' },
+		{ "size", required_argument, NULL, 's' },
+		{ "delay", required_argument, NULL, 'd' },
+		{ "workers", required_argument, NULL, 'w' },
+		{ "close", no_argument, NULL, OPT_CLOSE },
+		{ "keep-alive", no_argument, NULL, OPT_KEEP_ALIVE },
+		{ NULL, 0, NULL, 0 }
+	};
+	char *end;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "hp:s:d:w:", opts, NULL)) != -1) {
+		switch (c) {
+		case 'h':
+			usage(argv[0]);
+			exit(EXIT_SUCCESS);
+		case 'p':
+			port = strtoul(optarg, &end, 10);
+			if (*end || port == 0 || port > 65535) {
+				fprintf(stderr, "Invalid port '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 's':
+			body_size = strtoull(optarg, &end, 10);
+			if (*end) {
+				fprintf(stderr, "Invalid size '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'd':
+			delay = strtod(optarg, &end) / 1e3;
+			if (*end || delay < 0) {
+				fprintf(stderr, "Invalid delay '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'w':
+			num_workers = strtoul(optarg, &end, 10);
+			if (*end || num_workers == 0) {
+				fprintf(stderr, "Invalid number of workers '%s'\n", optarg);
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case OPT_CLOSE:
+			connection_mode = CONNECTION_CLOSE;
+			break;
+		case OPT_KEEP_ALIVE:
+			connection_mode = CONNECTION_KEEP_ALIVE;
+			break;
+		default:
+			usage(argv[0]);
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static int
+open_listener(void)
+{
+	struct sockaddr_in sin;
+	const int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+	if (fd == -1) {
+		fprintf(stderr, "socket() fails: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+#ifdef SO_REUSEPORT
+	/* Each worker gets its own socket, and the kernel spreads the connections */
+	setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof one);
+#endif
+	memset(&sin, 0, sizeof sin);
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	sin.sin_port = htons(port);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof sin) == -1 || listen(fd, 4096) == -1) {
+		fprintf(stderr, "Cannot listen on port %u: %s\n", port, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	return fd;
+}
+
+static void
+set_events(int fd, uint32_t events)
+{
+	struct sink_conn *c = &conns[fd];
+	struct epoll_event ev;
+
+	if (c->events == events)
+		return;
+	ev.events = events;
+	ev.data.fd = fd;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+		fprintf(stderr, "epoll_ctl fails: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	c->events = events;
+}
+
+static void
+close_conn(int fd)
+{
+	struct sink_conn *c = &conns[fd];
+
+	c->open = 0;
+	c->generation++;
+	close(fd); /* Also takes it out of the epoll set */
+}
+
+static void
+accept_conns(int listen_fd)
+{
+	const int one = 1;
+
+	while (1) {
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd == -1) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR
+			    && errno != ECONNABORTED)
+				fprintf(stderr, "accept fails: %s\n", strerror(errno));
+			return;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+		if (fd >= num_conns) {
+			int n = num_conns;
+			num_conns = fd + 1024;
+			conns = xrealloc(conns, num_conns * sizeof conns[0]);
+			memset(&conns[n], 0, (num_conns - n) * sizeof conns[0]);
+		}
+		struct sink_conn *c = &conns[fd];
+		if (!c->in)
+			c->in = xrealloc(NULL, MAX_REQUEST);
+		c->open = 1;
+		c->in_len = 0;
+		c->body_left = 0;
+		c->responding = 0;
+		c->events = EPOLLIN;
+
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = fd;
+		if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+			fprintf(stderr, "epoll_ctl fails: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+static int
+header_has(const char *headers, const char *name, const char *token)
+{
+	size_t name_len = strlen(name);
+	const char *line;
+
+	for (line = headers; line; line = strchr(line, '\n')) {
+		line++;
+		if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+			const char *end = strchr(line, '\n');
+			size_t len = end ? (size_t)(end - line) : strlen(line);
+			size_t n, token_len = strlen(token);
+			for (n = name_len; n + token_len <= len; n++) {
+				if (strncasecmp(line + n, token, token_len) == 0)
+					return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+static long long
+content_length(const char *headers)
+{
+	const char *line;
+
+	for (line = headers; line; line = strchr(line, '\n')) {
+		line++;
+		if (strncasecmp(line, "content-length:", 15) == 0)
+			return strtoll(line + 15, NULL, 10);
+	}
+	return 0;
+}
+
+/* Returns -1 if the connection was closed */
+static int
+send_response(int fd)
+{
+	struct sink_conn *c = &conns[fd];
+	const char *header = c->close_after ? header_close : header_keep_alive;
+	size_t header_len = c->close_after ? header_close_len : header_keep_alive_len;
+
+	while (c->out_pos < header_len + body_size) {
+		struct iovec iov[2];
+		int n = 0;
+		if (c->out_pos < header_len) {
+			iov[n].iov_base = (char *)header + c->out_pos;
+			iov[n++].iov_len = header_len - c->out_pos;
+		}
+		if (body_size) {
+			size_t body_pos = c->out_pos > header_len ? c->out_pos - header_len : 0;
+			iov[n].iov_base = body + body_pos;
+			iov[n++].iov_len = body_size - body_pos;
+		}
+		ssize_t written = writev(fd, iov, n);
+		if (written == -1) {
+			if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				set_events(fd, EPOLLOUT);
+				return 0;
+			}
+			if (errno == EINTR)
+				continue;
+			close_conn(fd);
+			return -1;
+		}
+		c->out_pos += written;
+	}
+	requests++;
+	c->responding = 0;
+	if (c->close_after) {
+		close_conn(fd);
+		return -1;
+	}
+	set_events(fd, EPOLLIN);
+	return 0;
+}
+
+static void
+delay_response(int fd)
+{
+	if (delayed_count == delayed_alloc) {
+		size_t n, new_alloc = delayed_alloc ? 2 * delayed_alloc : 1024;
+		struct delayed *bigger = xrealloc(NULL, new_alloc * sizeof bigger[0]);
+		for (n = 0; n < delayed_count; n++)
+			bigger[n] = delayed[(delayed_head + n) % delayed_alloc];
+		free(delayed);
+		delayed = bigger;
+		delayed_alloc = new_alloc;
+		delayed_head = 0;
+	}
+	struct delayed *d = &delayed[(delayed_head + delayed_count++) % delayed_alloc];
+	d->fd = fd;
+	d->generation = conns[fd].generation;
+	d->due = now() + delay;
+	set_events(fd, 0); /* Read no more until this response is out */
+}
+
+/* Take complete requests out of the input buffer and answer them, one at a
+   time. Returns -1 if the connection was closed. */
+static int
+handle_requests(int fd)
+{
+	struct sink_conn *c = &conns[fd];
+
+	while (c->open) {
+		if (c->responding && !c->body_left)
+			return 0; /* The response is delayed or waiting to be written */
+		if (!c->responding) {
+			c->in[c->in_len] = 0;
+			char *end = strstr(c->in, "\r\n\r\n");
+			if (!end) {
+				if (c->in_len == MAX_REQUEST - 1) {
+					fprintf(stderr, "Request headers too large, closing\n");
+					close_conn(fd);
+					return -1;
+				}
+				return 0;
+			}
+			*end = 0;
+			switch (connection_mode) {
+			case CONNECTION_AS_ASKED:
+				if (strstr(c->in, " HTTP/1.0\r\n"))
+					c->close_after = !header_has(c->in, "connection", "keep-alive");
+				else
+					c->close_after = header_has(c->in, "connection", "close");
+				break;
+			case CONNECTION_CLOSE:
+				c->close_after = 1;
+				break;
+			case CONNECTION_KEEP_ALIVE:
+				c->close_after = 0;
+				break;
+			}
+			long long cl = content_length(c->in);
+			c->body_left = cl > 0 ? cl : 0;
+			size_t used = end + 4 - c->in;
+			memmove(c->in, c->in + used, c->in_len - used);
+			c->in_len -= used;
+			c->responding = 1;
+			c->out_pos = 0;
+		}
+		if (c->body_left) {
+			size_t skip = c->body_left < c->in_len ? c->body_left : c->in_len;
+			memmove(c->in, c->in + skip, c->in_len - skip);
+			c->in_len -= skip;
+			c->body_left -= skip;
+			if (c->body_left)
+				return 0;
+		}
+		/* The request is complete */
+		if (delay > 0) {
+			delay_response(fd);
+			return 0;
+		}
+		if (send_response(fd) == -1)
+			return -1;
+	}
+	return 0;
+}
+
+/* Send the delayed responses that are due, and return the time until the
+   next one in ms, or -1 if there is none */
+static int
+send_delayed(void)
+{
+	double t = now();
+
+	while (delayed_count) {
+		struct delayed *d = &delayed[delayed_head];
+		if (d->due > t)
+			return (int)((d->due - t) * 1e3) + 1;
+		delayed_head = (delayed_head + 1) % delayed_alloc;
+		delayed_count--;
+		if (conns[d->fd].open && conns[d->fd].generation == d->generation &&
+		    send_response(d->fd) == 0)
+			handle_requests(d->fd); /* Requests pipelined behind it */
+	}
+	return -1;
+}
+
+static void
+handle_readable(int fd)
+{
+	struct sink_conn *c = &conns[fd];
+	ssize_t len = read(fd, c->in + c->in_len, MAX_REQUEST - 1 - c->in_len);
+
+	if (len == 0 || (len == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+		close_conn(fd);
+		return;
+	}
+	if (len > 0)
+		c->in_len += len;
+	handle_requests(fd);
+}
+
+static void
+signal_handler(int sig)
+{
+	(void)sig;
+	stop_now = 1;
+}
+
+static void
+serve(unsigned int worker)
+{
+	struct epoll_event events[MAX_EVENTS];
+	struct sigaction sa;
+	int listen_fd = open_listener();
+	double start = now();
+
+	memset(&sa, 0, sizeof sa);
+	sa.sa_handler = signal_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	signal(SIGPIPE, SIG_IGN);
+
+	epoll_fd = epoll_create(MAX_EVENTS);
+	if (epoll_fd == -1) {
+		fprintf(stderr, "Cannot create poll fd: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = listen_fd;
+	epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev);
+
+	while (!stop_now) {
+		int timeout = send_delayed();
+		int num_fds = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+		int n;
+
+		if (num_fds == -1) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "epoll_wait error: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		for (n = 0; n < num_fds; n++) {
+			int fd = events[n].data.fd;
+			if (fd == listen_fd) {
+				accept_conns(listen_fd);
+			} else if (!conns[fd].open) {
+				continue; /* Closed by an earlier event in this batch */
+			} else if (events[n].events & EPOLLOUT) {
+				if (send_response(fd) == 0)
+					handle_requests(fd);
+			} else if (events[n].events & EPOLLIN) {
+				handle_readable(fd);
+			} else {
+				close_conn(fd); /* Error or hangup while waiting to respond */
+			}
+		}
+	}
+
+	double elapsed = now() - start;
+	fprintf(stderr, "Worker %u: %lu responses in %.1fs, %.0f/s\n", worker, requests, elapsed,
+		requests / elapsed);
+}
+
+int
+main(int argc, char **argv)
+{
+	unsigned int w;
+
+	parse_arguments(argc, argv);
+
+	body = xrealloc(NULL, body_size + 1);
+	memset(body, 'x', body_size);
+	header_close_len = snprintf(header_close, sizeof header_close,
+				    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+				    "Content-Length: %zu\r\nConnection: close\r\n\r\n", body_size);
+	header_keep_alive_len = snprintf(header_keep_alive, sizeof header_keep_alive,
+					 "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+					 "Content-Length: %zu\r\n\r\n", body_size);
+
+	fprintf(stderr, "Listening on port %u with %u worker%s, %zu byte responses", port,
+		num_workers, num_workers == 1 ? "" : "s", body_size);
+	if (delay > 0)
+		fprintf(stderr, " after %.1fms", delay * 1e3);
+	fprintf(stderr, "\n");
+
+	if (num_workers == 1) {
+		serve(0);
+		exit(EXIT_SUCCESS);
+	}
+#ifndef SO_REUSEPORT
+	fprintf(stderr, "No SO_REUSEPORT on this system, cannot run several workers\n");
+	exit(EXIT_FAILURE);
+#endif
+	for (w = 0; w < num_workers; w++) {
+		pid_t pid = fork();
+		if (pid == -1) {
+			fprintf(stderr, "fork fails: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		if (pid == 0) {
+			serve(w);
+			exit(EXIT_SUCCESS);
+		}
+	}
+	/* The workers get the ^C too, and report when they stop */
+	signal(SIGINT, SIG_IGN);
+	while (wait(NULL) > 0 || errno == EINTR)
+		;
+	exit(EXIT_SUCCESS);
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "stats.h"
+#include "connection-info.h"
+#include "timeutil.h"
+
+struct run_stats run_stats;
+
+static const char *result_class_names[NUM_RESULT_CLASSES] = {
+	[RESULT_OK] = "ok",
+	[RESULT_HTTP_ERROR] = "http_error",
+	[RESULT_INVALID] = "invalid",
+	[RESULT_BAD_RESPONSE] = "bad_response",
+	[RESULT_CONNECT_ERROR] = "connect_error",
+	[RESULT_READ_ERROR] = "read_error",
+	[RESULT_WRITE_ERROR] = "write_error",
+};
+
+static const char *phase_names[NUM_PHASES] = {
+	[PHASE_CONNECT] = "connect",
+	[PHASE_FIRST_BYTE] = "first_byte",
+	[PHASE_TRANSFER] = "transfer",
+	[PHASE_TOTAL] = "total",
+};
+
+const char *
+result_class_name(enum result_class rc)
+{
+	return result_class_names[rc];
+}
+
+const char *
+phase_name(enum phase phase)
+{
+	return phase_names[phase];
+}
+
+unsigned long
+stats_total(void)
+{
+	unsigned long total = 0;
+	int rc;
+
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++)
+		total += run_stats.results[rc];
+	return total;
+}
+
+static void
+record_phases(struct phase_latency *l, const double *elapsed, const int *reached)
+{
+	int phase;
+
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+		if (reached[phase])
+			histogram_record(&l->phase[phase], elapsed[phase]);
+	}
+}
+
+struct phase_latency *
+stats_latency_for_status(int http_status)
+{
+	struct phase_latency **by_status = &run_stats.latency_by_status[http_status];
+	if (!*by_status) {
+		*by_status = calloc(1, sizeof **by_status);
+		if (!*by_status) {
+			fprintf(stderr, "calloc failed: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+	}
+	return *by_status;
+}
+
+void
+stats_record_latency(const struct conn_info *conn, int http_status, enum result_class result)
+{
+	double end = conn->finished_result_time ? conn->finished_result_time : now();
+	double elapsed[NUM_PHASES];
+	int reached[NUM_PHASES];
+
+	/* A failed query only gets the phases it got through */
+	reached[PHASE_CONNECT] = conn->connected_time != 0;
+	elapsed[PHASE_CONNECT] = conn->connected_time - conn->connect_time;
+	reached[PHASE_FIRST_BYTE] = reached[PHASE_TRANSFER] = conn->first_result_time != 0;
+	elapsed[PHASE_FIRST_BYTE] = conn->first_result_time - conn->connect_time;
+	elapsed[PHASE_TRANSFER] = end - conn->first_result_time;
+	reached[PHASE_TOTAL] = 1;
+	elapsed[PHASE_TOTAL] = end - conn->connect_time;
+
+	record_phases(&run_stats.latency_by_class[result], elapsed, reached);
+	if (http_status < 100 || http_status >= 600)
+		return;
+	record_phases(&run_stats.latency, elapsed, reached);
+	histogram_record(&run_stats.interval_latency, elapsed[PHASE_TOTAL]);
+	record_phases(stats_latency_for_status(http_status), elapsed, reached);
+}
+
+static void
+print_latency_row(FILE *f, const char *name, const struct phase_latency *l)
+{
+	int phase;
+
+	fprintf(f, "%-14s %10llu", name, (unsigned long long)l->phase[PHASE_TOTAL].count);
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+		const struct histogram *h = &l->phase[phase];
+		char cell[40] = "-";
+		if (h->count) {
+			snprintf(cell, sizeof cell, "%.2f/%.2f", 1e3 * histogram_mean(h),
+				 1e3 * histogram_percentile(h, 99));
+		}
+		fprintf(f, " %17s", cell);
+	}
+	fprintf(f, "\n");
+}
+
+void
+stats_print_latency(FILE *f)
+{
+	int phase, code, rc;
+	char name[20];
+
+	if (!run_stats.latency.phase[PHASE_TOTAL].count)
+		return;
+	fprintf(f, "Latency in ms, mean/p99:\n%-14s %10s", "", "Queries");
+	for (phase = 0; phase < NUM_PHASES; phase++)
+		fprintf(f, " %17s", phase_names[phase]);
+	fprintf(f, "\n");
+	print_latency_row(f, "all", &run_stats.latency);
+	for (code = 0; code < 600; code++) {
+		if (!run_stats.latency_by_status[code])
+			continue;
+		snprintf(name, sizeof name, "status %d", code);
+		print_latency_row(f, name, run_stats.latency_by_status[code]);
+	}
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++) {
+		if (run_stats.latency_by_class[rc].phase[PHASE_TOTAL].count)
+			print_latency_row(f, result_class_names[rc], &run_stats.latency_by_class[rc]);
+	}
+}
+
+void
+stats_print(FILE *f)
+{
+	int rc;
+
+	fprintf(f, "Results:");
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++)
+		fprintf(f, " %s=%lu", result_class_names[rc], run_stats.results[rc]);
+	fprintf(f, "\n");
+	if (run_stats.fastopen_attempted) {
+		fprintf(f, "TCP Fast Open: data in the SYN for %lu of %lu connections\n",
+			run_stats.fastopen_used, run_stats.fastopen_attempted);
+	}
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
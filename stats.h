@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+/* Counters for the whole run */
+
+#include <stdio.h>
+
+#include "histogram.h"
+
+struct conn_info;
+
+enum result_class {
+	RESULT_OK = 0,
+	RESULT_HTTP_ERROR,   /* Non-2xx status */
+	RESULT_INVALID,      /* 2xx, but failed a --expect/--reject rule */
+	RESULT_BAD_RESPONSE, /* Could not parse the response */
+	RESULT_CONNECT_ERROR, /* Out of local ports, refused, or a failed TLS handshake */
+	RESULT_READ_ERROR,
+	RESULT_WRITE_ERROR,
+	NUM_RESULT_CLASSES
+};
+
+/* Where the time of a query goes. All but the transfer are measured from
+   the connect(). */
+enum phase {
+	PHASE_CONNECT,    /* Until the connection is up */
+	PHASE_FIRST_BYTE, /* Until the first byte of the response */
+	PHASE_TRANSFER,   /* From the first byte until the response is complete */
+	PHASE_TOTAL,      /* Until the response is complete, or the query failed */
+	NUM_PHASES
+};
+
+struct phase_latency {
+	struct histogram phase[NUM_PHASES];
+};
+
+struct run_stats {
+	unsigned long results[NUM_RESULT_CLASSES];
+	unsigned long fastopen_attempted; /* Completed queries on TFO sockets */
+	unsigned long fastopen_used; /* ... where the server accepted data in the SYN */
+	unsigned long long response_bytes;
+	unsigned long status_codes[600]; /* Responses by HTTP status */
+	struct phase_latency latency; /* Queries with a response */
+	struct phase_latency *latency_by_status[600]; /* Allocated on first use */
+	struct phase_latency latency_by_class[NUM_RESULT_CLASSES];
+	unsigned long warmup; /* Queries that finished during the warm-up, not counted above */
+	struct histogram interval_latency; /* Total latency since the last progress report */
+};
+
+extern struct run_stats run_stats;
+
+const char *result_class_name(enum result_class);
+const char *phase_name(enum phase);
+void stats_print(FILE *);
+unsigned long stats_total(void); /* Queries with any result */
+/* http_status is 0 or -1 for a query without a proper response */
+void stats_record_latency(const struct conn_info *, int http_status, enum result_class);
+void stats_print_latency(FILE *);
+struct phase_latency *stats_latency_for_status(int http_status); /* 100..599 */
+
+#endif /* !STATS_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
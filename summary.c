@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "summary.h"
+#include "stats.h"
+#include "target.h"
+#include "group.h"
+#include "loop-stats.h"
+#include "histogram.h"
+
+/* All times in the summary are in seconds */
+
+static void
+put_string(FILE *f, const char *s)
+{
+	const unsigned char *p;
+
+	fputc('"', f);
+	for (p = (const unsigned char *)s; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			fprintf(f, "\\%c", *p);
+		else if (*p < 0x20)
+			fprintf(f, "\\u%04x", *p);
+		else
+			fputc(*p, f);
+	}
+	fputc('"', f);
+}
+
+static const char *
+boolean(int value)
+{
+	return value ? "true" : "false";
+}
+
+static double
+seconds(const struct timeval *tv)
+{
+	return tv->tv_sec + 1e-6 * tv->tv_usec;
+}
+
+static void
+put_latency(FILE *f, const struct histogram *h)
+{
+	fprintf(f, "{ \"count\": %llu, \"mean\": %.6f, \"min\": %.6f, \"p50\": %.6f, "
+		"\"p90\": %.6f, \"p99\": %.6f, \"p99.9\": %.6f, \"max\": %.6f }",
+		(unsigned long long)h->count, histogram_mean(h), h->min,
+		histogram_percentile(h, 50), histogram_percentile(h, 90),
+		histogram_percentile(h, 99), histogram_percentile(h, 99.9), h->max);
+}
+
+/* The phases of one breakdown, as an object indented by indent spaces */
+static void
+put_phases(FILE *f, int indent, const struct phase_latency *l)
+{
+	int phase;
+
+	fprintf(f, "{\n");
+	for (phase = 0; phase < NUM_PHASES; phase++) {
+		fprintf(f, "%*s  \"%s\": ", indent, "", phase_name(phase));
+		put_latency(f, &l->phase[phase]);
+		fprintf(f, "%s\n", phase + 1 < NUM_PHASES ? "," : "");
+	}
+	fprintf(f, "%*s}", indent, "");
+}
+
+static void
+put_params(FILE *f, const struct summary_params *p)
+{
+	unsigned int n;
+	int i;
+
+	fprintf(f, "  \"command_line\": [");
+	for (i = 0; i < p->argc; i++) {
+		if (i)
+			fputs(", ", f);
+		put_string(f, p->argv[i]);
+	}
+	fprintf(f, "],\n  \"parameters\": {\n    \"targets\": [");
+	for (n = 0; n < num_targets; n++) {
+		if (n)
+			fputs(", ", f);
+		put_string(f, targets[n].name);
+	}
+	fprintf(f, "],\n    \"parallel\": %u,\n", p->parallel);
+	if (p->offered_qps > 0)
+		fprintf(f, "    \"offered_qps\": %.3f,\n", p->offered_qps);
+	else
+		fprintf(f, "    \"offered_qps\": null,\n");
+	if (p->max_queries)
+		fprintf(f, "    \"max_queries\": %lu,\n", p->max_queries);
+	else
+		fprintf(f, "    \"max_queries\": null,\n");
+	fprintf(f, "    \"wait_mode\": \"%s\",\n    \"protocol\": \"%s\",\n"
+		"    \"tls\": %s,\n    \"loop\": %s,\n    \"randomize\": %s,\n"
+		"    \"seed\": %llu,\n    \"query_prefix\": ",
+		p->wait_mode, p->protocol, boolean(p->tls), boolean(p->loop),
+		boolean(p->randomize), (unsigned long long)p->seed);
+	put_string(f, p->query_prefix);
+	fprintf(f, ",\n    \"distribution\": ");
+	put_string(f, p->distribution ? p->distribution : "uniform");
+	fprintf(f, "\n  },\n");
+}
+
+static void
+put_results(FILE *f, const struct summary_params *p)
+{
+	double duration = p->end - p->start;
+	unsigned long completed = stats_total();
+	const char *sep = "";
+	int rc, code;
+
+	fprintf(f, "  \"start\": %.6f,\n  \"duration\": %.6f,\n", p->start, duration);
+	fprintf(f, "  \"queries\": { \"sent\": %lu, \"completed\": %lu, \"achieved_qps\": %.3f },\n",
+		p->sent, completed, duration > 0 ? completed / duration : 0);
+	fprintf(f, "  \"warmup\": { \"duration\": %.6f, \"sent\": %lu, \"completed\": %lu },\n",
+		p->warmup, p->warmup_sent, run_stats.warmup);
+	fprintf(f, "  \"response_bytes\": %llu,\n  \"results\": {", run_stats.response_bytes);
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++)
+		fprintf(f, "%s \"%s\": %lu", rc ? "," : "", result_class_name(rc),
+			run_stats.results[rc]);
+	fprintf(f, " },\n  \"status_codes\": {");
+	for (code = 0; code < 600; code++) {
+		if (!run_stats.status_codes[code])
+			continue;
+		fprintf(f, "%s \"%d\": %lu", sep, code, run_stats.status_codes[code]);
+		sep = ",";
+	}
+	fprintf(f, " },\n  \"latency\": ");
+	put_phases(f, 2, &run_stats.latency);
+	fprintf(f, ",\n  \"latency_by_status\": {");
+	sep = "";
+	for (code = 0; code < 600; code++) {
+		if (!run_stats.latency_by_status[code])
+			continue;
+		fprintf(f, "%s\n    \"%d\": ", sep, code);
+		put_phases(f, 4, run_stats.latency_by_status[code]);
+		sep = ",";
+	}
+	fprintf(f, "\n  },\n  \"latency_by_class\": {");
+	sep = "";
+	for (rc = 0; rc < NUM_RESULT_CLASSES; rc++) {
+		const struct phase_latency *l = &run_stats.latency_by_class[rc];
+		if (!l->phase[PHASE_TOTAL].count)
+			continue;
+		fprintf(f, "%s\n    \"%s\": ", sep, result_class_name(rc));
+		put_phases(f, 4, l);
+		sep = ",";
+	}
+	fprintf(f, "\n  },\n");
+}
+
+static void
+put_targets(FILE *f)
+{
+	unsigned int n;
+
+	fprintf(f, "  \"targets\": [\n");
+	for (n = 0; n < num_targets; n++) {
+		const struct target *t = &targets[n];
+		fprintf(f, "    { \"name\": ");
+		put_string(f, t->name);
+		fprintf(f, ", \"sent\": %lu, \"completed\": %lu, \"errors\": %lu, \"latency\": ",
+			t->sent, t->completed, t->errors);
+		put_latency(f, &t->latency);
+		fprintf(f, " }%s\n", n + 1 < num_targets ? "," : "");
+	}
+	fprintf(f, "  ],\n");
+}
+
+static void
+put_groups(FILE *f)
+{
+	const char *sep = "";
+	unsigned int n;
+
+	fprintf(f, "  \"groups\": [");
+	for (n = 0; n < num_groups; n++) {
+		const struct group *g = &groups[n];
+		if (!g->queries)
+			continue;
+		fprintf(f, "%s\n    { \"name\": ", sep);
+		put_string(f, g->name);
+		fprintf(f, ", \"queries\": %lu, \"sent\": %lu, \"completed\": %lu, "
+			"\"errors\": %lu, \"latency\": ", g->queries, g->sent, g->completed, g->errors);
+		put_latency(f, &g->latency);
+		fprintf(f, " }");
+		sep = ",";
+	}
+	fprintf(f, "\n  ],\n");
+}
+
+static void
+put_client(FILE *f)
+{
+	const struct loop_stats *l = &loop_stats;
+
+	fprintf(f, "  \"client\": {\n    \"send_lag\": ");
+	put_latency(f, &l->send_lag);
+	fprintf(f, ",\n    \"loop_iterations\": %lu,\n    \"loop_busy_mean\": %.6f,\n"
+		"    \"loop_busy_max\": %.6f,\n    \"events_per_wakeup\": %.3f,\n"
+		"    \"saturated_seconds\": %u\n  },\n", l->iterations,
+		l->iterations ? l->busy / l->iterations : 0, l->max_busy,
+		l->iterations ? (double)l->events / l->iterations : 0, l->saturated_intervals);
+}
+
+static void
+put_rusage(FILE *f)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) < 0) {
+		fprintf(stderr, "getrusage fails: %s\n", strerror(errno));
+		memset(&ru, 0, sizeof ru);
+	}
+	fprintf(f, "  \"rusage\": {\n"
+		"    \"user_cpu\": %.6f,\n    \"system_cpu\": %.6f,\n"
+		"    \"max_rss_kb\": %ld,\n    \"minor_faults\": %ld,\n    \"major_faults\": %ld,\n"
+		"    \"voluntary_switches\": %ld,\n    \"involuntary_switches\": %ld\n  }\n",
+		seconds(&ru.ru_utime), seconds(&ru.ru_stime), ru.ru_maxrss,
+		ru.ru_minflt, ru.ru_majflt, ru.ru_nvcsw, ru.ru_nivcsw);
+}
+
+void
+summary_write(const char *filename, const struct summary_params *params)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f) {
+		fprintf(stderr, "Cannot open '%s' for writing: %s\n", filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(f, "{\n");
+	put_params(f, params);
+	put_results(f, params);
+	put_targets(f);
+	put_groups(f);
+	put_client(f);
+	put_rusage(f);
+	fprintf(f, "}\n");
+
+	if (ferror(f) | fclose(f)) {
+		fprintf(stderr, "Cannot write '%s': %s\n", filename, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+/* A JSON summary of the whole run, for dashboards and scripts that should
+ * not have to parse the query log. */
+
+#include <stdint.h>
+
+struct summary_params {
+	int argc;
+	char **argv;
+	unsigned int parallel;
+	double offered_qps;        /* 0 means as fast as possible */
+	unsigned long max_queries; /* 0 means no limit */
+	const char *wait_mode;
+	const char *protocol;
+	const char *query_prefix;
+	int loop;
+	int randomize;
+	const char *distribution; /* NULL for uniform */
+	int tls;
+	uint64_t seed;
+	double start; /* After the warm-up */
+	double end;
+	unsigned long sent; /* Not counting the warm-up */
+	double warmup; /* Seconds */
+	unsigned long warmup_sent;
+};
+
+void summary_write(const char *filename, const struct summary_params *);
+
+#endif /* !SUMMARY_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
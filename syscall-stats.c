@@ -0,0 +1,59 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "syscall-stats.h"
+
+unsigned long syscall_counts[NUM_SYSCALL_KINDS];
+
+static const char *syscall_names[NUM_SYSCALL_KINDS] = {
+	[SC_SOCKET] = "socket",
+	[SC_FCNTL] = "fcntl",
+	[SC_SETSOCKOPT] = "setsockopt",
+	[SC_GETSOCKOPT] = "getsockopt",
+	[SC_BIND] = "bind",
+	[SC_CONNECT] = "connect",
+	[SC_WRITE] = "write",
+	[SC_READ] = "read",
+	[SC_SPLICE] = "splice",
+	[SC_SENDFILE] = "sendfile",
+	[SC_CLOSE] = "close",
+	[SC_POLL_CTL] = "poll_ctl",
+	[SC_POLL_WAIT] = "poll_wait",
+};
+
+void
+syscall_report(FILE *f, unsigned long queries)
+{
+	unsigned long total = 0;
+	int k;
+
+	if (!queries)
+		return;
+	fprintf(f, "Syscalls per query:");
+	for (k = 0; k < NUM_SYSCALL_KINDS; k++) {
+		if (!syscall_counts[k])
+			continue;
+		fprintf(f, " %s=%.2f", syscall_names[k], (double)syscall_counts[k] / queries);
+		total += syscall_counts[k];
+	}
+	fprintf(f, " total=%.2f\n", (double)total / queries);
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
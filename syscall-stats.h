@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef SYSCALL_STATS_H
+#define SYSCALL_STATS_H
+
+/* Count the system calls we make, so our own kernel overhead per query is
+ * visible next to the numbers we measure for the server. */
+
+#include <stdio.h>
+
+enum syscall_kind {
+	SC_SOCKET,
+	SC_FCNTL,
+	SC_SETSOCKOPT,
+	SC_GETSOCKOPT,
+	SC_BIND,
+	SC_CONNECT,
+	SC_WRITE,
+	SC_READ,
+	SC_SPLICE,
+	SC_SENDFILE,
+	SC_CLOSE,
+	SC_POLL_CTL,  /* epoll_ctl or kevent changes */
+	SC_POLL_WAIT, /* epoll_wait, poll or kevent waits */
+	NUM_SYSCALL_KINDS
+};
+
+extern unsigned long syscall_counts[NUM_SYSCALL_KINDS];
+
+#define count_syscall(kind) (syscall_counts[kind]++)
+
+void syscall_report(FILE *, unsigned long queries);
+
+#endif /* !SYSCALL_STATS_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "target.h"
+
+struct target *targets;
+unsigned int num_targets;
+
+struct target *
+target_add(const struct addrinfo *ai, const char *hostname, const char *name)
+{
+	targets = realloc(targets, (num_targets + 1) * sizeof targets[0]);
+	if (!targets) {
+		fprintf(stderr, "Failed to allocate memory for targets: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	struct target *t = &targets[num_targets++];
+	memset(t, 0, sizeof *t);
+	t->ai = ai;
+	t->hostname = hostname;
+	snprintf(t->name, sizeof t->name, "%s", name);
+	histogram_init(&t->latency);
+	return t;
+}
+
+struct target *
+target_pick(enum balance_mode mode)
+{
+	static unsigned int next;
+	unsigned int n, best;
+
+	switch (mode) {
+	case BALANCE_ROUND_ROBIN:
+		if (next >= num_targets)
+			next = 0;
+		return &targets[next++];
+	case BALANCE_LEAST_OUTSTANDING:
+		/* Start the scan after the last pick so ties are spread out */
+		best = next < num_targets ? next : 0;
+		for (n = 1; n < num_targets; n++) {
+			unsigned int idx = (best + n) % num_targets;
+			if (targets[idx].outstanding < targets[best].outstanding)
+				best = idx;
+		}
+		next = best + 1;
+		return &targets[best];
+	}
+	return &targets[0];
+}
+
+void
+target_report(FILE *f)
+{
+	unsigned int n;
+
+	fprintf(f, "%-28s %10s %10s %8s %9s %9s %9s %9s\n", "Target", "Sent", "Completed",
+		"Errors", "Mean", "p50", "p99", "Max");
+	for (n = 0; n < num_targets; n++) {
+		const struct target *t = &targets[n];
+		const struct histogram *h = &t->latency;
+		fprintf(f, "%-28s %10lu %10lu %8lu %7.1fms %7.1fms %7.1fms %7.1fms\n",
+			t->name, t->sent, t->completed, t->errors,
+			1e3 * histogram_mean(h), 1e3 * histogram_percentile(h, 50),
+			1e3 * histogram_percentile(h, 99), 1e3 * h->max);
+	}
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
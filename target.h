@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TARGET_H
+#define TARGET_H
+
+/* The addresses we send queries to, with separate statistics for each so a
+ * slow backend stands out. */
+
+#include <stdio.h>
+#include <netdb.h>
+
+#include "histogram.h"
+
+enum balance_mode {
+	BALANCE_ROUND_ROBIN,
+	BALANCE_LEAST_OUTSTANDING
+};
+
+struct target {
+	const struct addrinfo *ai;
+	const char *hostname; /* As given on the command line, for the Host header */
+	char name[NI_MAXHOST + NI_MAXSERV + 3]; /* Numeric address for reports */
+	unsigned int outstanding;
+	unsigned long sent;
+	unsigned long completed;
+	unsigned long errors;
+	struct histogram latency;
+	void *tls_session; /* SSL_SESSION * to resume */
+};
+
+extern struct target *targets;
+extern unsigned int num_targets;
+
+struct target *target_add(const struct addrinfo *ai, const char *hostname, const char *name);
+struct target *target_pick(enum balance_mode);
+void target_report(FILE *);
+
+#endif /* !TARGET_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "template.h"
+
+enum segment_kind { SEG_LITERAL, SEG_DICT, SEG_RAND, SEG_SEQ };
+
+struct dict {
+	struct dict *next;
+	char *name;
+	char *words; /* The file, with the newlines as NULs */
+	const char **word;
+	uint32_t *len;
+	size_t count;
+};
+
+struct segment {
+	enum segment_kind kind;
+	const char *text; /* SEG_LITERAL */
+	size_t len;
+	uint64_t low, span; /* SEG_RAND, span 0 means all of 2^64 */
+	const struct dict *dict;
+};
+
+struct template {
+	struct segment *segments;
+	unsigned int num_segments;
+	uint64_t seed;
+};
+
+static uint64_t next_instance;
+static struct dict *dicts; /* Loaded once, however many templates use them */
+
+static void *
+xmalloc(size_t size)
+{
+	void *p = malloc(size);
+	if (!p) {
+		fprintf(stderr, "malloc failed: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static int confined;
+
+void
+template_confine(void)
+{
+	confined = 1;
+}
+
+static const struct dict *
+load_dict(const char *filename, size_t name_len)
+{
+	char *name = xmalloc(name_len + 1);
+	memcpy(name, filename, name_len);
+	name[name_len] = 0;
+
+	struct dict *d;
+	for (d = dicts; d; d = d->next) {
+		if (!strcmp(d->name, name)) {
+			free(name);
+			return d;
+		}
+	}
+	if (confined && strchr(name, '/')) {
+		fprintf(stderr, "Template dictionary '%s' is not in the working directory\n",
+			name);
+		exit(EXIT_FAILURE);
+	}
+	FILE *f = fopen(name, "r");
+	if (!f) {
+		fprintf(stderr, "Cannot open template dictionary '%s': %s\n", name, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	d = xmalloc(sizeof *d);
+	size_t alloc = 65536, size = 0, got;
+	d->words = xmalloc(alloc + 1);
+	while ((got = fread(d->words + size, 1, alloc - size, f)) > 0) {
+		size += got;
+		if (size == alloc) {
+			alloc *= 2;
+			d->words = realloc(d->words, alloc + 1);
+			if (!d->words) {
+				fprintf(stderr, "realloc failed: %s\n", strerror(errno));
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	fclose(f);
+	d->words[size] = '\n';
+
+	size_t n, start = 0;
+	d->count = 0;
+	for (n = 0; n <= size; n++)
+		d->count += d->words[n] == '\n';
+	d->word = xmalloc(d->count * sizeof d->word[0]);
+	d->len = xmalloc(d->count * sizeof d->len[0]);
+	d->count = 0;
+	for (n = 0; n <= size; n++) {
+		if (d->words[n] != '\n')
+			continue;
+		size_t len = n - start;
+		if (len && d->words[n - 1] == '\r')
+			len--;
+		if (len) {
+			d->word[d->count] = d->words + start;
+			d->len[d->count++] = len;
+		}
+		start = n + 1;
+	}
+	if (!d->count) {
+		fprintf(stderr, "Template dictionary '%s' has no words\n", name);
+		exit(EXIT_FAILURE);
+	}
+	d->name = name;
+	d->next = dicts;
+	dicts = d;
+	return d;
+}
+
+static void
+bad_template(const char *spec, const char *why)
+{
+	fprintf(stderr, "Invalid template '%s': %s\n", spec, why);
+	exit(EXIT_FAILURE);
+}
+
+struct template *
+template_compile(const char *spec, uint64_t seed)
+{
+	struct template *t = xmalloc(sizeof *t);
+	const char *p = spec;
+
+	/* There are at most two segments per '{' plus one */
+	unsigned int max = 1;
+	for (; *p; p++)
+		max += 2 * (*p == '{');
+	t->segments = xmalloc(max * sizeof t->segments[0]);
+	t->num_segments = 0;
+	t->seed = seed;
+
+	for (p = spec; *p; ) {
+		struct segment *s = &t->segments[t->num_segments++];
+		memset(s, 0, sizeof *s);
+		if (*p != '{' || p[1] == '{') {
+			/* {{ is a literal { */
+			s->kind = SEG_LITERAL;
+			s->text = p;
+			if (*p == '{')
+				p += 2, s->text++;
+			p += strcspn(p, "{");
+			s->len = p - s->text;
+			continue;
+		}
+		const char *end = strchr(p, '}');
+		if (!end)
+			bad_template(spec, "missing '}'");
+		p++;
+		if (end - p == 3 && !strncmp(p, "seq", 3)) {
+			s->kind = SEG_SEQ;
+		} else if (!strncmp(p, "dict:", 5) && end - p > 5) {
+			s->kind = SEG_DICT;
+			s->dict = load_dict(p + 5, end - p - 5);
+		} else if (!strncmp(p, "rand:", 5)) {
+			char *e;
+			unsigned long long low = strtoull(p + 5, &e, 10), high;
+			if (e == p + 5 || strncmp(e, "..", 2))
+				bad_template(spec, "use {rand:<low>..<high>}");
+			const char *h = e + 2;
+			high = strtoull(h, &e, 10);
+			if (e == h || e != end || high < low)
+				bad_template(spec, "use {rand:<low>..<high>}");
+			s->kind = SEG_RAND;
+			s->low = low;
+			s->span = high - low + 1;
+		} else {
+			bad_template(spec, "the generators are {dict:<file>}, {rand:<low>..<high>} "
+				     "and {seq}");
+		}
+		p = end + 1;
+	}
+	return t;
+}
+
+/* splitmix64's finalizer, a good 64 bit mix */
+static inline uint64_t
+mix(uint64_t z)
+{
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static inline size_t
+put_uint(char *buf, size_t room, uint64_t v)
+{
+	char digits[20];
+	size_t n = 0, i, len;
+	do {
+		digits[n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	len = n < room ? n : room;
+	for (i = 0; i < len; i++)
+		buf[i] = digits[n - 1 - i];
+	return len;
+}
+
+size_t
+template_expand(const struct template *t, uint64_t n, char *buf, size_t len)
+{
+	size_t pos = 0, room;
+	unsigned int i;
+
+	if (!len)
+		return 0;
+	room = len - 1;
+	for (i = 0; i < t->num_segments && pos < room; i++) {
+		const struct segment *s = &t->segments[i];
+		/* Each generator gets its own stream */
+		uint64_t r = mix(t->seed + (n * t->num_segments + i) * 0x9e3779b97f4a7c15ULL);
+		size_t l;
+		switch (s->kind) {
+		case SEG_LITERAL:
+			l = s->len < room - pos ? s->len : room - pos;
+			memcpy(buf + pos, s->text, l);
+			pos += l;
+			break;
+		case SEG_DICT: {
+			size_t w = r % s->dict->count;
+			l = s->dict->len[w] < room - pos ? s->dict->len[w] : room - pos;
+			memcpy(buf + pos, s->dict->word[w], l);
+			pos += l;
+			break;
+		}
+		case SEG_RAND:
+			pos += put_uint(buf + pos, room - pos, s->low + (s->span ? r % s->span : r));
+			break;
+		case SEG_SEQ:
+			pos += put_uint(buf + pos, room - pos, n);
+			break;
+		}
+	}
+	buf[pos] = 0;
+	return pos;
+}
+
+uint64_t
+template_instance(void)
+{
+	return next_instance++;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TEMPLATE_H
+#define TEMPLATE_H
+
+/* Query templates like /search?q={dict:words.txt}&user={rand:1..1000}&n={seq}.
+ * A template is compiled once into literal segments and generators, and
+ * expanded straight into the caller's buffer. Each expansion is a pure
+ * function of the seed and an instance number, so the same text can be
+ * produced again for the query log without keeping it around. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum { TEMPLATE_MAX_LEN = 8192 }; /* Longer expansions are cut off */
+
+struct template;
+
+struct template *template_compile(const char *spec, uint64_t seed);
+/* Write instance n of the template to buf, truncated and NUL terminated
+   like snprintf. Returns the length written. */
+size_t template_expand(const struct template *, uint64_t n, char *buf, size_t len);
+uint64_t template_instance(void); /* The next instance number */
+void template_confine(void); /* Dictionaries only from the working directory */
+
+#endif /* !TEMPLATE_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,240 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+
+#include "tls.h"
+#include "debug.h"
+#include "timeutil.h"
+#include "connection-info.h"
+#include "target.h"
+#include "histogram.h"
+
+static SSL_CTX *ctx;
+static int use_ktls;
+static unsigned long handshakes;
+static unsigned long handshakes_resumed;
+static unsigned long handshakes_failed;
+static unsigned long ktls_connections;
+static struct histogram handshake_time;
+static struct histogram handshake_time_resumed;
+
+/* Called by OpenSSL when the server hands us a session (or a TLS 1.3 ticket,
+   which arrives after the handshake). Keep the latest one per target. */
+static int
+new_session(SSL *ssl, SSL_SESSION *session)
+{
+	struct conn_info *conn = SSL_get_app_data(ssl);
+	struct target *target = conn->target;
+	if (target->tls_session)
+		SSL_SESSION_free(target->tls_session);
+	target->tls_session = session;
+	return 1; /* We keep the reference */
+}
+
+void
+tls_init(int resume, int ktls)
+{
+	ctx = SSL_CTX_new(TLS_client_method());
+	if (!ctx) {
+		fprintf(stderr, "Cannot create TLS context: %s\n",
+			ERR_error_string(ERR_get_error(), NULL));
+		exit(EXIT_FAILURE);
+	}
+	/* We are measuring the server, not checking who it is */
+	SSL_CTX_set_verify(ctx, SSL_VERIFY_NONE, NULL);
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+	/* Servers that send Connection: close often skip close_notify */
+	SSL_CTX_set_options(ctx, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+	if (resume) {
+		SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT
+					       | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(ctx, new_session);
+	} else {
+		SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+		SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+	}
+	if (ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+		SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+		use_ktls = 1;
+#else
+		fprintf(stderr, "This OpenSSL does not support kTLS, ignoring --ktls\n");
+#endif
+	}
+	histogram_init(&handshake_time);
+	histogram_init(&handshake_time_resumed);
+}
+
+void
+tls_start(struct conn_info *conn)
+{
+	SSL *ssl = SSL_new(ctx);
+	if (!ssl) {
+		fprintf(stderr, "SSL_new fails: %s\n", ERR_error_string(ERR_get_error(), NULL));
+		exit(EXIT_FAILURE);
+	}
+	SSL_set_fd(ssl, conn->fd);
+	SSL_set_app_data(ssl, conn);
+	SSL_set_connect_state(ssl);
+
+	/* SNI with the host name part of host:port, unless it is an IP address */
+	const char *hostname = conn->target->hostname;
+	size_t len = strcspn(hostname, ":");
+	char *name = alloca(len + 1);
+	unsigned char addr[16];
+	memcpy(name, hostname, len);
+	name[len] = 0;
+	if (inet_pton(AF_INET, name, addr) != 1 && inet_pton(AF_INET6, name, addr) != 1)
+		SSL_set_tlsext_host_name(ssl, name);
+
+	if (conn->target->tls_session)
+		SSL_set_session(ssl, conn->target->tls_session);
+	conn->tls = ssl;
+	conn->tls_resumed = 0;
+}
+
+enum tls_status
+tls_handshake(struct conn_info *conn)
+{
+	SSL *ssl = conn->tls;
+
+	ERR_clear_error();
+	int ret = SSL_do_handshake(ssl);
+	if (ret == 1) {
+		double elapsed = now() - conn->connected_time;
+		handshakes++;
+		conn->tls_resumed = SSL_session_reused(ssl);
+		if (conn->tls_resumed) {
+			handshakes_resumed++;
+			histogram_record(&handshake_time_resumed, elapsed);
+		} else {
+			histogram_record(&handshake_time, elapsed);
+		}
+#ifdef BIO_get_ktls_send
+		if (use_ktls && BIO_get_ktls_send(SSL_get_wbio(ssl)))
+			ktls_connections++;
+#endif
+		debug("fd %d: TLS handshake done, %s, resumed=%d\n", conn->fd,
+		      SSL_get_version(ssl), conn->tls_resumed);
+		return TLS_DONE;
+	}
+
+	switch (SSL_get_error(ssl, ret)) {
+	case SSL_ERROR_WANT_READ:
+		return TLS_WANT_READ;
+	case SSL_ERROR_WANT_WRITE:
+		return TLS_WANT_WRITE;
+	case SSL_ERROR_SYSCALL:
+		fprintf(stderr, "TLS handshake on fd %d fails: %s\n", conn->fd,
+			errno ? strerror(errno) : "unexpected EOF");
+		break;
+	default:
+		fprintf(stderr, "TLS handshake on fd %d fails: %s\n", conn->fd,
+			ERR_error_string(ERR_get_error(), NULL));
+		break;
+	}
+	handshakes_failed++;
+	return TLS_ERROR;
+}
+
+static ssize_t
+tls_result(SSL *ssl, int ret)
+{
+	switch (SSL_get_error(ssl, ret)) {
+	case SSL_ERROR_ZERO_RETURN:
+		return 0;
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		errno = EWOULDBLOCK;
+		return -1;
+	case SSL_ERROR_SYSCALL:
+		if (!errno)
+			return 0; /* EOF without close_notify */
+		return -1;
+	default:
+		debug("TLS error: %s\n", ERR_error_string(ERR_get_error(), NULL));
+		errno = EPROTO;
+		return -1;
+	}
+}
+
+ssize_t
+tls_read(struct conn_info *conn, void *buf, size_t len)
+{
+	ERR_clear_error();
+	errno = 0;
+	int ret = SSL_read(conn->tls, buf, len);
+	return ret > 0 ? ret : tls_result(conn->tls, ret);
+}
+
+ssize_t
+tls_write(struct conn_info *conn, const void *buf, size_t len)
+{
+	ERR_clear_error();
+	errno = 0;
+	int ret = SSL_write(conn->tls, buf, len);
+	return ret > 0 ? ret : tls_result(conn->tls, ret);
+}
+
+void
+tls_close(struct conn_info *conn)
+{
+	SSL *ssl = conn->tls;
+	if (!ssl)
+		return;
+	/* Pretend a clean shutdown so OpenSSL does not mark the session as
+	   unusable, without paying for sending close_notify. */
+	if (SSL_is_init_finished(ssl))
+		SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+	SSL_free(ssl);
+	conn->tls = NULL;
+}
+
+void
+tls_report(FILE *f)
+{
+	fprintf(f, "TLS handshakes: %lu full, %lu resumed, %lu failed", handshakes - handshakes_resumed,
+		handshakes_resumed, handshakes_failed);
+	if (use_ktls)
+		fprintf(f, ", %lu with kTLS", ktls_connections);
+	fprintf(f, "\n");
+	if (handshake_time.count) {
+		fprintf(f, "  full handshake:    mean %.2fms p50 %.2fms p99 %.2fms\n",
+			1e3 * histogram_mean(&handshake_time),
+			1e3 * histogram_percentile(&handshake_time, 50),
+			1e3 * histogram_percentile(&handshake_time, 99));
+	}
+	if (handshake_time_resumed.count) {
+		fprintf(f, "  resumed handshake: mean %.2fms p50 %.2fms p99 %.2fms\n",
+			1e3 * histogram_mean(&handshake_time_resumed),
+			1e3 * histogram_percentile(&handshake_time_resumed, 50),
+			1e3 * histogram_percentile(&handshake_time_resumed, 99));
+	}
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
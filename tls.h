@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TLS_H
+#define TLS_H
+
+/* TLS transport on top of the nonblocking connection state machine. Only
+ * compiled in when the Makefile finds OpenSSL (HAVE_OPENSSL). */
+
+#include <stdio.h>
+#include <sys/types.h>
+
+struct conn_info;
+
+enum tls_status {
+	TLS_DONE,
+	TLS_WANT_READ,
+	TLS_WANT_WRITE,
+	TLS_ERROR
+};
+
+#ifdef HAVE_OPENSSL
+
+void tls_init(int resume, int ktls);
+void tls_start(struct conn_info *conn);
+enum tls_status tls_handshake(struct conn_info *conn);
+ssize_t tls_read(struct conn_info *conn, void *buf, size_t len); /* Like read(2) */
+ssize_t tls_write(struct conn_info *conn, const void *buf, size_t len); /* Like write(2) */
+void tls_close(struct conn_info *conn);
+void tls_report(FILE *);
+
+#else
+
+static inline void tls_init(int resume, int ktls) { (void)resume; (void)ktls; }
+static inline void tls_start(struct conn_info *conn) { (void)conn; }
+static inline enum tls_status tls_handshake(struct conn_info *conn) { (void)conn; return TLS_ERROR; }
+static inline ssize_t tls_read(struct conn_info *conn, void *buf, size_t len)
+{ (void)conn; (void)buf; (void)len; return -1; }
+static inline ssize_t tls_write(struct conn_info *conn, const void *buf, size_t len)
+{ (void)conn; (void)buf; (void)len; return -1; }
+static inline void tls_close(struct conn_info *conn) { (void)conn; }
+static inline void tls_report(FILE *f) { (void)f; }
+
+#endif /* HAVE_OPENSSL */
+
+#endif /* !TLS_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -25,8 +25,11 @@
 #include "debug.h"
 #include "wait-interface.h"
 #include "connection-info.h"
+#include "syscall-stats.h"
+#include "loop-stats.h"
 
 static unsigned int pending_queries = 0;
+static unsigned int num_services = 0;
 static int epoll_fd = -1;
 
 void
@@ -37,6 +40,7 @@ init_wait(int max_pending)
 		fprintf(stderr, "Cannot create poll fd: %s", strerror(errno));
 		exit(EXIT_FAILURE);
 	}
+	epoll_fd = fd_above_connections(epoll_fd);
 }
 
 void
@@ -44,17 +48,21 @@ wait_for_action(struct expdecay *qps, double timeout)
 {
 	debug("polling for %d fds\n", pending_queries);
 	
-	if (!pending_queries) {
+	if (!pending_queries && !num_services) {
 		struct timespec ts;
 		ts.tv_sec = (time_t)timeout;
 		timeout -= ts.tv_sec;
 		ts.tv_nsec = 1e9 * timeout;
 		nanosleep(&ts, NULL);
+		loop_stats_wakeup(0);
 		return;
 	}
 
-	struct epoll_event *events = alloca(pending_queries * sizeof events[0]);
-	int num_fds = epoll_wait(epoll_fd, events, pending_queries, 1e3 * timeout);
+	unsigned int max_events = pending_queries + num_services;
+	struct epoll_event *events = alloca(max_events * sizeof events[0]);
+	int num_fds = epoll_wait(epoll_fd, events, max_events, 1e3 * timeout);
+	count_syscall(SC_POLL_WAIT);
+	loop_stats_wakeup(num_fds > 0 ? num_fds : 0);
 	if (num_fds == -1) {
 		if (errno == EINTR) {
 			fprintf(stderr, "epoll_wait was interrupted by a signal.\n");
@@ -81,7 +89,9 @@ wait_for_connected(struct conn_info *conn)
 	ev.events = EPOLLOUT;
 	ev.data.ptr = conn;
 
+	conn->read_registered = 0;
 	int err = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev);
+	count_syscall(SC_POLL_CTL);
 	if (err == -1) {
 		fprintf(stderr, "wait_for_connected: epoll_ctl(%d, ADD, %d, ..): %s\n",
 			epoll_fd, conn->fd, strerror(errno));
@@ -90,6 +100,27 @@ wait_for_connected(struct conn_info *conn)
 	pending_queries++;
 }
 
+void
+wait_for_connected_then_read(struct conn_info *conn)
+{
+	struct epoll_event ev;
+
+	/* Edge triggered, or we would spin on the writable socket while waiting
+	   for the response */
+	ev.events = EPOLLOUT | EPOLLIN | EPOLLET;
+	ev.data.ptr = conn;
+
+	conn->read_registered = 1;
+	int err = epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev);
+	count_syscall(SC_POLL_CTL);
+	if (err == -1) {
+		fprintf(stderr, "wait_for_connected_then_read: epoll_ctl(%d, ADD, %d, ..): %s\n",
+			epoll_fd, conn->fd, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	pending_queries++;
+}
+
 void
 unregister_wait(struct conn_info *conn)
 {
@@ -104,11 +135,15 @@ wait_for_read(struct conn_info *conn)
 {
 	int fd = conn->fd;
 
+	if (conn->read_registered)
+		return;
+
 	struct epoll_event ev;
 	ev.events = EPOLLIN;
 	ev.data.ptr = conn;
 
 	int err = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+	count_syscall(SC_POLL_CTL);
 	if (err == -1) {
 		fprintf(stderr, "wait_for_read: epoll_ctl(%d, EPOLL_CTL_MOD): %s\n",
 			fd, strerror(errno));
@@ -116,6 +151,66 @@ wait_for_read(struct conn_info *conn)
 	}
 }
 
+void
+wait_for_write(struct conn_info *conn)
+{
+	int fd = conn->fd;
+
+	struct epoll_event ev;
+	ev.events = EPOLLOUT;
+	ev.data.ptr = conn;
+
+	conn->read_registered = 0; /* Replaces the registration from wait_for_connected_then_read() */
+	int err = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+	count_syscall(SC_POLL_CTL);
+	if (err == -1) {
+		fprintf(stderr, "wait_for_write: epoll_ctl(%d, EPOLL_CTL_MOD): %s\n",
+			fd, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+void
+wait_for_read_write(struct conn_info *conn)
+{
+	int fd = conn->fd;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLOUT;
+	ev.data.ptr = conn;
+
+	int err = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev);
+	count_syscall(SC_POLL_CTL);
+	if (err == -1) {
+		fprintf(stderr, "wait_for_read_write: epoll_ctl(%d, EPOLL_CTL_MOD): %s\n",
+			fd, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+void
+wait_for_service(struct conn_info *conn)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	ev.data.ptr = conn;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conn->fd, &ev) == -1) {
+		fprintf(stderr, "wait_for_service: epoll_ctl(%d, ADD, %d, ..): %s\n",
+			epoll_fd, conn->fd, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	num_services++;
+}
+
+void
+unregister_service(struct conn_info *conn)
+{
+	/* Followed by a close(), like unregister_wait() */
+	(void)conn;
+	num_services--;
+}
+
 unsigned int
 wait_num_pending(void)
 {
@@ -31,7 +31,20 @@ void wait_for_action(struct expdecay *query_stats, double timeout); /* timeout i
 void unregister_wait(struct conn_info *conn);
 unsigned int wait_num_pending(void);
 void wait_for_connected(struct conn_info *conn);
+/* Register for the connect and for the response in one go, so wait_for_read()
+   after sending the query costs nothing. The handlers must cope with being
+   called for either. */
+void wait_for_connected_then_read(struct conn_info *conn);
 void wait_for_read(struct conn_info *conn);
+void wait_for_write(struct conn_info *conn);
+void wait_for_read_write(struct conn_info *conn);
+
+/* Service sockets, like the metrics listener and its clients, are polled
+   along with the queries but are not counted by wait_num_pending(). They
+   only ever wait for reading. */
+enum { MAX_SERVICE_FDS = 8 };
+void wait_for_service(struct conn_info *conn);
+void unregister_service(struct conn_info *conn);
 
 #endif /* !WAIT_POLL_H  */
 
@@ -25,8 +25,11 @@
 #include "debug.h"
 #include "wait-interface.h"
 #include "connection-info.h"
+#include "syscall-stats.h"
+#include "loop-stats.h"
 
 static unsigned int pending_queries = 0;
+static unsigned int num_services = 0;
 static int kqueue_fd = -1;
 
 void
@@ -38,6 +41,7 @@ init_wait(int max_pending)
 		fprintf(stderr, "Cannot create kqueue fd: %s", strerror(errno));
 		exit(EXIT_FAILURE);
 	}
+	kqueue_fd = fd_above_connections(kqueue_fd);
 }
 
 void
@@ -51,13 +55,17 @@ wait_for_action(struct expdecay *query_stats, double timeout)
 	timeout -= ts.tv_sec;
 	ts.tv_nsec = 1e9 * timeout;
 
-	if (pending_queries == 0) {
+	if (pending_queries == 0 && num_services == 0) {
 		nanosleep(&ts, NULL);
+		loop_stats_wakeup(0);
 		return;
 	}
 
-	struct kevent *events = alloca(pending_queries * sizeof events[0]);
-	int num_fds = kevent(kqueue_fd, NULL, 0, events, pending_queries, &ts);
+	unsigned int max_events = pending_queries + num_services;
+	struct kevent *events = alloca(max_events * sizeof events[0]);
+	int num_fds = kevent(kqueue_fd, NULL, 0, events, max_events, &ts);
+	count_syscall(SC_POLL_WAIT);
+	loop_stats_wakeup(num_fds > 0 ? num_fds : 0);
 	if (num_fds == -1) {
 		if (errno == EINTR) {
 			fprintf(stderr, "kevent was interrupted by a signal.\n");
@@ -83,7 +91,9 @@ wait_for_connected(struct conn_info *conn)
 	int fd = conn->fd;
 
 	EV_SET(&kev, fd, EVFILT_WRITE, EV_ADD | EV_ONESHOT,  0, 0, conn);
+	conn->read_registered = 0;
 	int err = kevent(kqueue_fd, &kev, 1, NULL, 0, NULL);
+	count_syscall(SC_POLL_CTL);
 	if (err == -1) {
 		fprintf(stderr, "wait_for_connected: kevent(%d, %d, EVFILT_WRITE, EV_ADD): %s\n",
 			kqueue_fd, fd, strerror(errno));
@@ -92,6 +102,25 @@ wait_for_connected(struct conn_info *conn)
 	pending_queries++;
 }
 
+void
+wait_for_connected_then_read(struct conn_info *conn)
+{
+	struct kevent kev[2];
+	int fd = conn->fd;
+
+	EV_SET(&kev[0], fd, EVFILT_WRITE, EV_ADD | EV_ONESHOT,  0, 0, conn);
+	EV_SET(&kev[1], fd, EVFILT_READ, EV_ADD,  0, 0, conn);
+	conn->read_registered = 1;
+	int err = kevent(kqueue_fd, kev, 2, NULL, 0, NULL);
+	count_syscall(SC_POLL_CTL);
+	if (err == -1) {
+		fprintf(stderr, "wait_for_connected_then_read: kevent(%d, %d, EV_ADD): %s\n",
+			kqueue_fd, fd, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	pending_queries++;
+}
+
 void
 unregister_wait(struct conn_info *conn)
 {
@@ -105,8 +134,11 @@ void
 wait_for_read(struct conn_info *conn)
 {
 	struct kevent kev;
+	if (conn->read_registered)
+		return;
 	EV_SET(&kev, conn->fd, EVFILT_READ, EV_ADD,  0, 0, conn);
 	int err = kevent(kqueue_fd, &kev, 1, NULL, 0, NULL);
+	count_syscall(SC_POLL_CTL);
 	if (err == -1) {
 		fprintf(stderr, "wait_for_read: kevent(%d, %d, EVFILT_READ, EV_ADD): %s\n",
 			kqueue_fd, conn->fd, strerror(errno));
@@ -114,6 +146,50 @@ wait_for_read(struct conn_info *conn)
 	}
 }
 
+void
+wait_for_write(struct conn_info *conn)
+{
+	/* A read filter may still be registered, the handlers cope with being
+	   called for the wrong kind of event */
+	struct kevent kev;
+	EV_SET(&kev, conn->fd, EVFILT_WRITE, EV_ADD | EV_ONESHOT,  0, 0, conn);
+	int err = kevent(kqueue_fd, &kev, 1, NULL, 0, NULL);
+	count_syscall(SC_POLL_CTL);
+	if (err == -1) {
+		fprintf(stderr, "wait_for_write: kevent(%d, %d, EVFILT_WRITE, EV_ADD): %s\n",
+			kqueue_fd, conn->fd, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+}
+
+void
+wait_for_read_write(struct conn_info *conn)
+{
+	wait_for_read(conn);
+	wait_for_write(conn);
+}
+
+void
+wait_for_service(struct conn_info *conn)
+{
+	struct kevent kev;
+	EV_SET(&kev, conn->fd, EVFILT_READ, EV_ADD,  0, 0, conn);
+	if (kevent(kqueue_fd, &kev, 1, NULL, 0, NULL) == -1) {
+		fprintf(stderr, "wait_for_service: kevent(%d, %d, EVFILT_READ, EV_ADD): %s\n",
+			kqueue_fd, conn->fd, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	num_services++;
+}
+
+void
+unregister_service(struct conn_info *conn)
+{
+	/* Followed by a close(), like unregister_wait() */
+	(void)conn;
+	num_services--;
+}
+
 unsigned int
 wait_num_pending(void)
 {
@@ -24,21 +24,34 @@
 #include "debug.h"
 #include "wait-interface.h"
 #include "connection-info.h"
+#include "syscall-stats.h"
+#include "loop-stats.h"
 
+/* The queries are in pending_list[0 .. pending_queries), and the service fds
+   are copied in after them for each poll() */
 static struct pollfd *pending_list;
 static unsigned int pending_queries = 0;
+static struct conn_info *services[MAX_SERVICE_FDS];
+static unsigned int num_services = 0;
 
 void
 init_wait(int max_pending)
 {
-	pending_list = calloc(max_pending, sizeof(pending_list[0]));
+	pending_list = calloc(max_pending + MAX_SERVICE_FDS, sizeof(pending_list[0]));
 }
 
 void
 wait_for_action(struct expdecay *query_stats, double delay)
 {
 	debug("polling for %d fds\n", pending_queries);
-	int num_fds = poll(pending_list, pending_queries, 1e3 * delay);
+	unsigned int n, s;
+	for (s = 0; s < num_services; s++) {
+		pending_list[pending_queries + s].fd = services[s]->fd;
+		pending_list[pending_queries + s].events = POLLIN;
+	}
+	int num_fds = poll(pending_list, pending_queries + num_services, 1e3 * delay);
+	count_syscall(SC_POLL_WAIT);
+	loop_stats_wakeup(num_fds > 0 ? num_fds : 0);
 	if (num_fds == -1) {
 		if (errno == EINTR) {
 			fprintf(stderr, "Poll was interrupted by a signal.\n");
@@ -49,7 +62,16 @@ wait_for_action(struct expdecay *query_stats, double delay)
 	}
 	debug("%d fds ready for something\n", num_fds);
 
-	unsigned int n;
+	/* Note which services are ready before the query handlers move things around */
+	struct conn_info *ready[MAX_SERVICE_FDS];
+	unsigned int num_ready = 0;
+	for (s = 0; s < num_services; s++) {
+		if (pending_list[pending_queries + s].revents) {
+			ready[num_ready++] = services[s];
+			num_fds--;
+		}
+	}
+
 	for (n = 0; num_fds && n < pending_queries; n++) {
 		struct pollfd *p = &pending_list[n];
 		if (p->revents) {
@@ -59,6 +81,8 @@ wait_for_action(struct expdecay *query_stats, double delay)
 			num_fds--;
 		}
 	}
+	for (s = 0; s < num_ready; s++)
+		ready[s]->handler(query_stats, ready[s]);
 }
 
 
@@ -71,6 +95,14 @@ wait_for_connected(struct conn_info *conn)
 	pending_queries++;
 }
 
+void
+wait_for_connected_then_read(struct conn_info *conn)
+{
+	/* Changing what we poll for is free here, and a level triggered POLLIN |
+	   POLLOUT would keep firing while we wait for the response */
+	wait_for_connected(conn);
+}
+
 #define SWAP(a, b)				\
 do {						\
 	__typeof(a) tmp = (a);			\
@@ -102,6 +134,37 @@ wait_for_read(struct conn_info *conn)
 	pending_list[conn->pending_index].events = POLLIN;
 }
 
+void
+wait_for_write(struct conn_info *conn)
+{
+	pending_list[conn->pending_index].events = POLLOUT;
+}
+
+void
+wait_for_read_write(struct conn_info *conn)
+{
+	pending_list[conn->pending_index].events = POLLIN | POLLOUT;
+}
+
+void
+wait_for_service(struct conn_info *conn)
+{
+	rt_assert(num_services < MAX_SERVICE_FDS);
+	services[num_services++] = conn;
+}
+
+void
+unregister_service(struct conn_info *conn)
+{
+	unsigned int s;
+	for (s = 0; s < num_services; s++) {
+		if (services[s] == conn) {
+			services[s] = services[--num_services];
+			return;
+		}
+	}
+}
+
 unsigned int
 wait_num_pending(void)
 {
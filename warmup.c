@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "warmup.h"
+#include "stats.h"
+#include "histogram.h"
+#include "syscall-stats.h"
+
+/* In auto mode, the rate and the median must stay within the tolerance
+   for this many seconds. We give up waiting after AUTO_MAX seconds. */
+enum { AUTO_SECONDS = 5, AUTO_MAX = 120 };
+
+enum warmup_mode { WARMUP_NONE, WARMUP_SECONDS, WARMUP_QUERIES, WARMUP_AUTO };
+
+int warming_up;
+
+static enum warmup_mode mode = WARMUP_NONE;
+static double seconds, tolerance = 0.1;
+static unsigned long queries;
+static double run_start, measure_start;
+static unsigned long sent_during;
+
+/* The last AUTO_SECONDS intervals */
+static double rates[AUTO_SECONDS], medians[AUTO_SECONDS];
+static unsigned int num_intervals;
+static unsigned long last_completed;
+static double last_interval;
+
+void
+warmup_parse(const char *arg)
+{
+	char *end;
+
+	if (strncmp(arg, "auto", 4) == 0) {
+		mode = WARMUP_AUTO;
+		if (arg[4] == ':') {
+			tolerance = strtod(arg + 5, &end) / 100;
+			if (end == arg + 5 || *end || !(tolerance > 0))
+				goto invalid;
+		} else if (arg[4]) {
+			goto invalid;
+		}
+		return;
+	}
+	double n = strtod(arg, &end);
+	if (end == arg || !(n > 0))
+		goto invalid;
+	if (!strcmp(end, "s")) {
+		mode = WARMUP_SECONDS;
+		seconds = n;
+		return;
+	}
+	if (*end || n != floor(n))
+		goto invalid;
+	mode = WARMUP_QUERIES;
+	queries = n;
+	return;
+
+invalid:
+	fprintf(stderr, "Invalid warm-up '%s', give <n>s for seconds, <n> for queries "
+		"or auto[:<tolerance %%>]\n", arg);
+	exit(EXIT_FAILURE);
+}
+
+void
+warmup_start(double start)
+{
+	run_start = measure_start = last_interval = start;
+	warming_up = mode != WARMUP_NONE;
+}
+
+static void
+finish(double timestamp, unsigned long sent, const char *why)
+{
+	warming_up = 0;
+	measure_start = timestamp;
+	sent_during = sent;
+	/* So the syscalls per query are for the measured queries */
+	memset(syscall_counts, 0, sizeof syscall_counts);
+	fprintf(stderr, "\nWarm-up done after %.1fs and %lu queries%s\n", timestamp - run_start,
+		sent, why);
+}
+
+void
+warmup_check(double timestamp, unsigned long sent)
+{
+	if (mode == WARMUP_SECONDS && timestamp - run_start >= seconds)
+		finish(timestamp, sent, "");
+	else if (mode == WARMUP_QUERIES && sent >= queries)
+		finish(timestamp, sent, "");
+}
+
+/* Within the tolerance of the mean */
+static int
+stable(const double *v)
+{
+	double min = v[0], max = v[0], sum = 0;
+	unsigned int n;
+	for (n = 0; n < AUTO_SECONDS; n++) {
+		if (v[n] < min)
+			min = v[n];
+		if (v[n] > max)
+			max = v[n];
+		sum += v[n];
+	}
+	return sum > 0 && max - min <= tolerance * sum / AUTO_SECONDS;
+}
+
+void
+warmup_interval(double timestamp, unsigned long sent)
+{
+	double length = timestamp - last_interval;
+	if (!warming_up || mode != WARMUP_AUTO || length <= 0)
+		return;
+
+	unsigned int slot = num_intervals++ % AUTO_SECONDS;
+	rates[slot] = (run_stats.warmup - last_completed) / length;
+	medians[slot] = histogram_percentile(&run_stats.interval_latency, 50);
+	last_completed = run_stats.warmup;
+	last_interval = timestamp;
+
+	if (num_intervals >= AUTO_SECONDS && stable(rates) && stable(medians))
+		finish(timestamp, sent, ", the rate and median latency are stable");
+	else if (timestamp - run_start >= AUTO_MAX)
+		finish(timestamp, sent, ", but the rate or median latency never settled");
+}
+
+double
+warmup_end(void)
+{
+	return measure_start;
+}
+
+unsigned long
+warmup_queries(void)
+{
+	return sent_during;
+}
+
+void
+warmup_merged(double end, unsigned long sent)
+{
+	warming_up = 0;
+	measure_start = end;
+	sent_during = sent;
+}
+
+void
+warmup_report(FILE *f)
+{
+	if (mode == WARMUP_NONE)
+		return;
+	if (warming_up)
+		fprintf(f, "WARNING: the run ended during the warm-up, nothing was measured\n");
+	else
+		fprintf(f, "Warm-up: %.1fs, %lu queries sent, %lu finished, not counted above\n",
+			measure_start - run_start, sent_during, run_stats.warmup);
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef WARMUP_H
+#define WARMUP_H
+
+/* The first part of a run, while the server warms its caches and the
+ * connections get going, is not representative. Queries sent during the
+ * warm-up are marked in the query log and left out of the statistics. It
+ * ends after a number of seconds or queries, or once the rate and the
+ * median latency have settled. */
+
+#include <stdio.h>
+
+extern int warming_up;
+
+void warmup_parse(const char *arg); /* <n>s, <n> queries or auto[:<tolerance %>] */
+void warmup_start(double start);
+void warmup_check(double timestamp, unsigned long sent); /* Before sending a query */
+void warmup_interval(double timestamp, unsigned long sent); /* Once a second */
+double warmup_end(void); /* When the measurement started */
+unsigned long warmup_queries(void); /* Sent during the warm-up */
+/* On the coordinator, after warmup_start(): the agents' warm-ups, merged */
+void warmup_merged(double end, unsigned long sent);
+void warmup_report(FILE *);
+
+#endif /* !WARMUP_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
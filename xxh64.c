@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include <string.h>
+
+#include "xxh64.h"
+
+#define P1 0x9e3779b185ebca87ULL
+#define P2 0xc2b2ae3d27d4eb4fULL
+#define P3 0x165667b19e3779f9ULL
+#define P4 0x85ebca77c2b2ae63ULL
+#define P5 0x27d4eb2f165667c5ULL
+
+static inline uint64_t
+rotl(uint64_t x, int k)
+{
+	return (x << k) | (x >> (64 - k));
+}
+
+/* Little endian loads, which compilers turn into a single mov on x86 */
+static inline uint64_t
+read64(const unsigned char *p)
+{
+	return (uint64_t)p[0] | (uint64_t)p[1] << 8 | (uint64_t)p[2] << 16
+		| (uint64_t)p[3] << 24 | (uint64_t)p[4] << 32 | (uint64_t)p[5] << 40
+		| (uint64_t)p[6] << 48 | (uint64_t)p[7] << 56;
+}
+
+static inline uint32_t
+read32(const unsigned char *p)
+{
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16
+		| (uint32_t)p[3] << 24;
+}
+
+static inline uint64_t
+round64(uint64_t acc, uint64_t input)
+{
+	acc += input * P2;
+	acc = rotl(acc, 31);
+	return acc * P1;
+}
+
+static inline uint64_t
+merge_round(uint64_t acc, uint64_t val)
+{
+	acc ^= round64(0, val);
+	return acc * P1 + P4;
+}
+
+void
+xxh64_init(struct xxh64 *h, uint64_t seed)
+{
+	h->v[0] = seed + P1 + P2;
+	h->v[1] = seed + P2;
+	h->v[2] = seed;
+	h->v[3] = seed - P1;
+	h->total = 0;
+	h->buffered = 0;
+	h->seed = seed;
+}
+
+/* The four lanes are independent, so they run in parallel */
+static const unsigned char *
+stripes(uint64_t *v, const unsigned char *p, const unsigned char *end)
+{
+	uint64_t v0 = v[0], v1 = v[1], v2 = v[2], v3 = v[3];
+	for (; p + 32 <= end; p += 32) {
+		v0 = round64(v0, read64(p));
+		v1 = round64(v1, read64(p + 8));
+		v2 = round64(v2, read64(p + 16));
+		v3 = round64(v3, read64(p + 24));
+	}
+	v[0] = v0;
+	v[1] = v1;
+	v[2] = v2;
+	v[3] = v3;
+	return p;
+}
+
+void
+xxh64_update(struct xxh64 *h, const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	const unsigned char *end = p + len;
+
+	h->total += len;
+	if (h->buffered + len < 32) {
+		memcpy(h->buf + h->buffered, p, len);
+		h->buffered += len;
+		return;
+	}
+	if (h->buffered) {
+		size_t fill = 32 - h->buffered;
+		memcpy(h->buf + h->buffered, p, fill);
+		stripes(h->v, h->buf, h->buf + 32);
+		p += fill;
+		h->buffered = 0;
+	}
+	p = stripes(h->v, p, end);
+	h->buffered = end - p;
+	memcpy(h->buf, p, h->buffered);
+}
+
+uint64_t
+xxh64_digest(const struct xxh64 *h)
+{
+	const unsigned char *p = h->buf;
+	const unsigned char *end = p + h->buffered;
+	uint64_t x;
+
+	if (h->total >= 32) {
+		x = rotl(h->v[0], 1) + rotl(h->v[1], 7) + rotl(h->v[2], 12) + rotl(h->v[3], 18);
+		x = merge_round(x, h->v[0]);
+		x = merge_round(x, h->v[1]);
+		x = merge_round(x, h->v[2]);
+		x = merge_round(x, h->v[3]);
+	} else {
+		x = h->seed + P5;
+	}
+	x += h->total;
+
+	for (; p + 8 <= end; p += 8) {
+		x ^= round64(0, read64(p));
+		x = rotl(x, 27) * P1 + P4;
+	}
+	if (p + 4 <= end) {
+		x ^= read32(p) * P1;
+		x = rotl(x, 23) * P2 + P3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		x ^= *p * P5;
+		x = rotl(x, 11) * P1;
+	}
+
+	x ^= x >> 33;
+	x *= P2;
+	x ^= x >> 29;
+	x *= P3;
+	x ^= x >> 32;
+	return x;
+}
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2011, Finn Arne Gangstad <finnag@cxense.com>
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef XXH64_H
+#define XXH64_H
+
+/* XXH64, a fast 64 bit non-cryptographic hash, fed incrementally so a
+ * response can be hashed as it arrives. Gives the same values as the
+ * reference xxHash implementation. */
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct xxh64 {
+	uint64_t v[4];
+	uint64_t total;
+	unsigned char buf[32]; /* Input not yet making up a whole stripe */
+	unsigned int buffered;
+	uint64_t seed;
+};
+
+void xxh64_init(struct xxh64 *, uint64_t seed);
+void xxh64_update(struct xxh64 *, const void *data, size_t len);
+uint64_t xxh64_digest(const struct xxh64 *);
+
+#endif /* !XXH64_H */
+
+/* Local Variables: */
+/* c-basic-offset:8 */
+/* indent-tabs-mode:t */
+/* End:  */